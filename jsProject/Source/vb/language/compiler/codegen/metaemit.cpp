@@ -16,6 +16,9 @@
 #undef IfFailGo
 #define IfFailGo(EXPR) IfFailGoto(EXPR, Error)
 
+// How much of an embedded resource file is read into the PE at a time.
+#define RESOURCE_READ_CHUNK_SIZE    ((DWORD)(1024 * 1024))
+
 static const DWORD rgPEKind[] =
 {
     peILonly,                   // platformAgnostic
@@ -5696,29 +5699,65 @@ ULONG MetaEmit::ALinkEmitOneResource
 
     if (presource->m_fEmbed)
     {
-        // We're embedding the resource, so map the file
-        // and copy its contents into the PE.
-        MapFile mapfile;
+        // We're embedding the resource, so read the file straight into
+        // the PE, a chunk at a time.  (Mapping it and copying the view
+        // faulted the whole file into the working set on top of the
+        // section's copy, which doubled peak memory for large resources.)
+        DWORD   cbFile = 0;
+        HANDLE  hFile = OpenFileEx(presource->m_pstrFile, &cbFile);
 
-        mapfile.Map(presource->m_pstrFile, pErrorTable);
-        if (mapfile.FMapped())
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            pErrorTable->CreateErrorWithError(
+                            ERRID_UnableToOpenFile1,
+                            NULL,
+                            GetLastHResultError(),
+                            presource->m_pstrFile);
+        }
+        else
         {
-            DWORD   cbFile;
             void   *pvBuffer;
 
-            cbFile = mapfile.CbFile();
-
             // Size of the resource includes 4-byte size prefix
             cbResource = cbFile + sizeof(DWORD);
-            IfFalseThrow(cbResource >= cbFile);
+            if (cbResource < cbFile)
+            {
+                CloseHandle(hFile);
+                VbThrow(E_OUTOFMEMORY);
+            }
 
             // Write size of resource (in bytes) followed by resource's bits
             hr = pFileGen->GetSectionBlock(hCeeSection, cbResource, 1, &pvBuffer);
             if (SUCCEEDED(hr))
             {
                 memcpy(pvBuffer, &cbFile, sizeof(DWORD));
-                memcpy((PBYTE)pvBuffer + sizeof(DWORD), mapfile.PbMapAddr(), cbFile);
 
+                PBYTE   pbNext = (PBYTE)pvBuffer + sizeof(DWORD);
+                DWORD   cbLeft = cbFile;
+
+                while (cbLeft > 0 && SUCCEEDED(hr))
+                {
+                    DWORD cbRead = 0;
+
+                    if (!ReadFile(hFile, pbNext, min(cbLeft, RESOURCE_READ_CHUNK_SIZE), &cbRead, NULL))
+                    {
+                        hr = GetLastHResultError();
+                    }
+                    else if (cbRead == 0)
+                    {
+                        // The file got shorter since we sized it.
+                        hr = HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+                    }
+
+                    pbNext += cbRead;
+                    cbLeft -= cbRead;
+                }
+            }
+
+            CloseHandle(hFile);
+
+            if (SUCCEEDED(hr))
+            {
                 hr = m_pALink->EmbedResource(
                     m_mdAssemblyOrModule,     // IN - Unique ID for the assembly
                     m_mdAssemblyOrModule,     // IN - FileToken or AssemblyID of file that has the resource
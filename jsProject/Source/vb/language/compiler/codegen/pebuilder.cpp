@@ -65,6 +65,41 @@ CodeGenInfo::CodeGenInfo(ILTree::ILNode * pBoundTree, BCSYM_Proc * pProc, Source
 {
 }
 
+#if !IDE
+
+PreparsedMethodBodies::PreparsedMethodBodies() : m_pSourceFile(NULL), m_pText(NULL)
+{
+    memset(m_rgpnraTrees, 0, sizeof(m_rgpnraTrees));
+}
+
+PreparsedMethodBodies::~PreparsedMethodBodies()
+{
+    for (ULONG i = 0; i < m_daBodies.Count(); i++)
+    {
+        delete m_daBodies.Element(i).m_pErrors;
+    }
+
+    for (unsigned i = 0; i < _countof(m_rgpnraTrees); i++)
+    {
+        delete m_rgpnraTrees[i];
+    }
+}
+
+PreparsedMethodBody * PreparsedMethodBodies::Take(BCSYM_Proc * pProc)
+{
+    ULONG iBody;
+
+    if (m_BodyIndex.GetValue(pProc, &iBody))
+    {
+        m_BodyIndex.Remove(pProc);
+        return &m_daBodies.Element(iBody);
+    }
+
+    return NULL;
+}
+
+#endif !IDE
+
 //============================================================================
 // Class that implements IMetaDataError, which we pass to IALink2::Init
 // to get warning callbacks.
@@ -5146,6 +5181,21 @@ ILTree::ILNode *PEBuilder::GenerateBoundTreeForProc
 
             if (!pTree)
             {
+                ParseTree::MethodBodyStatement *pPreparsedTree = NULL;
+
+#if !IDE
+                PreparsedMethodBody *pPreparsed = m_pPreparsedMethodBodies ? m_pPreparsedMethodBodies->Take(pProc) : NULL;
+
+                if (pPreparsed)
+                {
+                    // Report the parse errors where parsing here would have.
+                    pErrorTable->MergeTemporaryTable(pPreparsed->m_pErrors);
+                    IfFailThrow(pPreparsed->m_hr);
+
+                    pPreparsedTree = pPreparsed->m_pTree;
+                }
+#endif
+
                 IfFailThrow(
                     pSourceFile->GetBoundMethodBodyTrees(
                         pProc,
@@ -5161,7 +5211,9 @@ ILTree::ILNode *PEBuilder::GenerateBoundTreeForProc
                         NULL,
                         pProc->IsAnyConstructor() && pContainer->GetNextPartialType() ?     // Code in constructors in partial types
                             SourceFile::GetCurrentErrorTableForFile :                           // could be from different files. Eg: Member initializers
-                            NULL));
+                            NULL,
+                        NULL,
+                        pPreparsedTree));
 #if IDE    
                 if (CheckStop(NULL)) // if the foreground thread wants to stop the bkd, then let's abort so IDE is more responsive
                 {
@@ -5622,6 +5674,14 @@ bool PEBuilder::CompileMethodsOfContainer
     NorlsAllocator nraBoundTrees(NORLSLOC);
     DynamicArray<CodeGenInfo> codeGenInfos;
 
+#if !IDE
+    PreparsedMethodBodies preparsed;
+    PreparseMethodBodies(pContainer, pTextInSourceFile, &preparsed);
+
+    BackupValue<PreparsedMethodBodies *> backupPreparsed(&m_pPreparsedMethodBodies);
+    m_pPreparsedMethodBodies = &preparsed;
+#endif
+
     // Open transaction on transient symbol store so that changes can be rolled back on Abort
     m_Transients.StartTransaction();
 
@@ -5665,6 +5725,118 @@ Abort:
     return fAborted;
 }
 
+#if !IDE
+
+//============================================================================
+// Parse the bodies of the methods in a container on several threads, so
+// that GenerateBoundTreesForContainer only has to bind them.  Binding and
+// code generation still happen one method at a time in the usual order, so
+// the IL and metadata tokens emitted do not depend on the threads.
+//============================================================================
+
+void PEBuilder::PreparseMethodBodies
+(
+    BCSYM_Container *pContainer,
+    Text *pText,
+    _Out_ PreparsedMethodBodies *pPreparsed
+)
+{
+    unsigned cThreads = ParallelWork::GetThreadCount();
+    if (cThreads <= 1)
+    {
+        return;
+    }
+
+    SourceFile *pSourceFile = pContainer->GetSourceFile();
+    DynamicArray<BCSYM_Proc *> daProcs;
+    BCSYM_Proc *pProc;
+    CompileableMethodsInAContainer iter(pContainer);
+
+    while (pProc = iter.Next())
+    {
+        // Only the bodies GenerateBoundTreeForProc would parse, and only
+        // those in this file because pText is shared by all the threads.
+        if (!pProc->IsTransient() &&
+            pProc->IsMethodImpl() &&
+            pProc->GetBindingSpace() != BINDSPACE_IgnoreSymbol &&
+            !pProc->GetBoundTree() &&
+            pProc->GetSourceFile() == pSourceFile)
+        {
+            daProcs.AddElement(pProc);
+        }
+    }
+
+    if (daProcs.Count() < 2)
+    {
+        return;
+    }
+
+    TIMEBLOCK(TIME_ParserMethodBody);
+
+    ErrorTable *pErrorTable = pSourceFile->GetCurrentErrorTable();
+
+    pPreparsed->m_pSourceFile = pSourceFile;
+    pPreparsed->m_pText = pText;
+
+    for (ULONG i = 0; i < daProcs.Count(); i++)
+    {
+        PreparsedMethodBody body;
+        body.m_pProc = daProcs.Element(i);
+        body.m_pErrors = new ErrorTable(*pErrorTable);
+        body.m_pTree = NULL;
+        body.m_hr = NOERROR;
+
+        pPreparsed->m_daBodies.AddElement(body);
+        pPreparsed->m_BodyIndex.SetValue(body.m_pProc, i);
+    }
+
+    cThreads = min(cThreads, daProcs.Count());
+
+    for (unsigned i = 0; i < cThreads; i++)
+    {
+        pPreparsed->m_rgpnraTrees[i] = new NorlsAllocator(NORLSLOC);
+    }
+
+    // Link the file's conditional compilation scope to the project's here, once, so
+    // that the parsers on the other threads find it linked and don't change it under
+    // each other while they evaluate #If (see Parser::ParseMethodBody).
+    BCSYM_Container *pConditionalConstants = pSourceFile->GetConditionalCompilationConstants();
+    BCSYM_Container *pProjectLevelCondCompScope = pSourceFile->GetProject()->GetProjectLevelCondCompScope();
+
+    if (pConditionalConstants)
+    {
+        Symbols::ClearParent(pConditionalConstants->PCCContainer());
+
+        if (pProjectLevelCondCompScope)
+        {
+            Symbols::SetParent(pConditionalConstants->PCCContainer(), pProjectLevelCondCompScope->GetHash());
+        }
+    }
+
+    ParallelWork::Run(PreparseMethodBodyWorkItem, pPreparsed, pPreparsed->m_daBodies.Count(), cThreads, TIME_ParserMethodBody);
+
+    if (pConditionalConstants)
+    {
+        // Clear the CC scope's parent (see VS RAID 231584)
+        Symbols::ClearParent(pConditionalConstants->PCCContainer());
+    }
+}
+
+void PEBuilder::PreparseMethodBodyWorkItem(void *pvPreparsed, unsigned iThread, long iBody)
+{
+    PreparsedMethodBodies *pPreparsed = (PreparsedMethodBodies *)pvPreparsed;
+    PreparsedMethodBody &body = pPreparsed->m_daBodies.Element(iBody);
+
+    body.m_hr = pPreparsed->m_pSourceFile->GetUnboundMethodBodyTrees(
+        body.m_pProc,
+        pPreparsed->m_rgpnraTrees[iThread],
+        body.m_pErrors,
+        pPreparsed->m_pText,
+        &body.m_pTree);
+}
+
+#endif !IDE
+
 BCSYM_ApplAttr * PEBuilder::FindFirstAttributeWithType(BCSYM_Param * pParam, BCSYM_NamedRoot * pAttributeType)
 {
     VSASSERT(pParam, "FindAttribute was supplied a null parameter.");
@@ -6356,6 +6528,8 @@ void PEBuilder::WritePE
 
     if (fDoSecondHalf)
     {
+        m_fHasImageContentHash = false;
+
 #if IDE 
         // Only increment the FCN counter in the VBA case.
         // Otherwise this now occurs in CompilerPackage::EndProjectCompilation since
@@ -6468,6 +6642,17 @@ void PEBuilder::WritePE
                 }
             }
 
+            // Stamp the image before it gets signed; the signature covers it.
+            if (m_pCompilerProject->IsDeterministicOutput())
+            {
+                StampDeterministicImage(fCompileToMemory ? *ppImage : NULL, pstrFileName);
+
+                if (m_pCompilerProject->GetContentHashFile())
+                {
+                    WriteImageContentHash(m_pCompilerProject->GetContentHashFile());
+                }
+            }
+
             // Tell ALink to sign the assembly.  We do this whether we're
             // emitting an assembly or a module.
             pMetaemitHelper->ALinkSignAssembly();
@@ -6517,6 +6702,802 @@ void PEBuilder::WriteDllCharacteristics(PEInfo *pInfo,WORD DllCharacteristics)
     return;
 }
 
+//============================================================================
+// Deterministic output.
+//
+// With /deterministic, the fields of the PE that differ between two builds
+// of the same inputs -- the time stamps in the file header and the debug
+// directory, the checksum, the module's MVID and the PDB signature in the
+// CodeView record -- are left out of a hash of the image, and are then stamped
+// from that hash.  With /contenthash:<file> as well, the hash is written to
+// <file> as hex, so that a build cache can tell whether the output changed
+// without comparing files.
+//
+// The symbol writer picks a random PDB GUID and gives us no way to choose it,
+// so once the PDB is closed its GUID is overwritten with the one stamped into
+// the CodeView record, keeping the two matched.  Then the PE is the same for
+// the same inputs, and so is the PDB's identity (GUID and age), which is what
+// debuggers and symbol servers go by.  The rest of the PDB isn't stamped.  A
+// PDB written to a stream rather than a file keeps the writer's GUID, and then
+// only the hash is the same for the same inputs.
+//============================================================================
+
+// The most debug directory entries we look at.
+#define MAX_DEBUG_DIRECTORY_ENTRIES     8
+
+// The fields of a PE image, as file offsets, that vary between builds.  An
+// offset of 0 means the field isn't there.
+struct PEVolatileFields
+{
+    DWORD m_ibTimeStamp;
+    DWORD m_ibCheckSum;
+    DWORD m_ibMvid;
+    DWORD m_rgibDebugTimeStamp[MAX_DEBUG_DIRECTORY_ENTRIES];
+    DWORD m_rgibPdbSignature[MAX_DEBUG_DIRECTORY_ENTRIES];     // GUID and age
+    DWORD m_rgcbPdbPath[MAX_DEBUG_DIRECTORY_ENTRIES];          // room for the PDB's path after them
+    unsigned m_cDebugEntries;
+};
+
+#define PDB_SIGNATURE_SIZE      (sizeof(GUID) + sizeof(DWORD))
+
+static const BYTE *GetNtHeaders(const BYTE *pbImage, size_t cbImage)
+{
+    if (cbImage < sizeof(IMAGE_DOS_HEADER) ||
+        ((const IMAGE_DOS_HEADER *)pbImage)->e_magic != IMAGE_DOS_SIGNATURE)
+    {
+        return NULL;
+    }
+
+    DWORD ibNtHeaders = ((const IMAGE_DOS_HEADER *)pbImage)->e_lfanew;
+
+    if (ibNtHeaders > cbImage ||
+        cbImage - ibNtHeaders < sizeof(IMAGE_NT_HEADERS64) ||
+        ((const IMAGE_NT_HEADERS32 *)(pbImage + ibNtHeaders))->Signature != IMAGE_NT_SIGNATURE)
+    {
+        return NULL;
+    }
+
+    return pbImage + ibNtHeaders;
+}
+
+// Returns the size of the image GenerateCeeMemoryImage laid out at pbImage.
+static size_t GetMemoryImageSize(const BYTE *pbImage)
+{
+    const IMAGE_NT_HEADERS32 *pNtHeaders = (const IMAGE_NT_HEADERS32 *)GetNtHeaders(pbImage, (size_t)-1);
+
+    if (!pNtHeaders)
+    {
+        return 0;
+    }
+
+    const IMAGE_SECTION_HEADER *rgSections = IMAGE_FIRST_SECTION(pNtHeaders);
+    size_t cbImage = pNtHeaders->OptionalHeader.SizeOfHeaders;
+
+    for (WORD iSection = 0; iSection < pNtHeaders->FileHeader.NumberOfSections; iSection++)
+    {
+        cbImage = max(cbImage, (size_t)rgSections[iSection].PointerToRawData + rgSections[iSection].SizeOfRawData);
+    }
+
+    return cbImage;
+}
+
+// Maps cb bytes at rva to a file offset.  Returns false if they aren't all
+// in one section of the image.
+static bool RvaToFileOffset
+(
+    const IMAGE_NT_HEADERS32 *pNtHeaders,
+    size_t cbImage,
+    DWORD rva,
+    DWORD cb,
+    _Out_ DWORD *pib
+)
+{
+    const IMAGE_SECTION_HEADER *rgSections = IMAGE_FIRST_SECTION(pNtHeaders);
+
+    for (WORD iSection = 0; iSection < pNtHeaders->FileHeader.NumberOfSections; iSection++)
+    {
+        const IMAGE_SECTION_HEADER &section = rgSections[iSection];
+
+        if (rva >= section.VirtualAddress &&
+            rva - section.VirtualAddress <= section.SizeOfRawData &&
+            cb <= section.SizeOfRawData - (rva - section.VirtualAddress))
+        {
+            *pib = section.PointerToRawData + (rva - section.VirtualAddress);
+            return *pib <= cbImage && cb <= cbImage - *pib;
+        }
+    }
+
+    return false;
+}
+
+// Finds the file offset of the module's MVID in the metadata at ibMetadata.
+static DWORD FindMvid
+(
+    const BYTE *pbImage,
+    DWORD ibMetadata,
+    DWORD cbMetadata
+)
+{
+    const BYTE *pbMetadata = pbImage + ibMetadata;
+    const BYTE *pbTables = NULL;
+    const BYTE *pbGuids = NULL;
+    DWORD cbTables = 0;
+    DWORD cbGuids = 0;
+
+    // The metadata root: signature, version, then the stream headers.
+    if (cbMetadata < 16 || *(const DWORD *)pbMetadata != 0x424A5342)
+    {
+        return 0;
+    }
+
+    DWORD ib = 16 + *(const DWORD *)(pbMetadata + 12);
+
+    if (ib > cbMetadata - 4)
+    {
+        return 0;
+    }
+
+    WORD cStreams = *(const WORD *)(pbMetadata + ib + 2);
+    ib += 4;
+
+    for (WORD iStream = 0; iStream < cStreams; iStream++)
+    {
+        if (ib > cbMetadata - 8)
+        {
+            return 0;
+        }
+
+        DWORD ibStream = *(const DWORD *)(pbMetadata + ib);
+        DWORD cbStream = *(const DWORD *)(pbMetadata + ib + 4);
+        const char *szName = (const char *)(pbMetadata + ib + 8);
+        size_t cchName = strnlen(szName, cbMetadata - ib - 8);
+
+        if (ibStream > cbMetadata || cbStream > cbMetadata - ibStream)
+        {
+            return 0;
+        }
+
+        if (cchName == 2 && (!memcmp(szName, "#~", 2) || !memcmp(szName, "#-", 2)))
+        {
+            pbTables = pbMetadata + ibStream;
+            cbTables = cbStream;
+        }
+        else if (cchName == 5 && !memcmp(szName, "#GUID", 5))
+        {
+            pbGuids = pbMetadata + ibStream;
+            cbGuids = cbStream;
+        }
+
+        ib += 8 + (DWORD)((cchName + 4) & ~3);
+    }
+
+    if (!pbTables || !pbGuids || cbTables < 24)
+    {
+        return 0;
+    }
+
+    // The tables header: heap sizes, the present tables and their row counts,
+    // then the rows, Module's first.  A Module row is Generation, Name, Mvid.
+    BYTE HeapSizes = pbTables[6];
+    UINT64 PresentTables = *(const UINT64 *)(pbTables + 8);
+
+    if (!(PresentTables & 1))
+    {
+        return 0;
+    }
+
+    DWORD ibModule = 24;
+
+    for (; PresentTables; PresentTables &= PresentTables - 1)
+    {
+        ibModule += sizeof(DWORD);
+    }
+
+    if (HeapSizes & 0x40)
+    {
+        ibModule += sizeof(DWORD);
+    }
+
+    DWORD ibMvidIndex = ibModule + sizeof(WORD) + ((HeapSizes & 0x01) ? 4 : 2);
+    DWORD cbMvidIndex = (HeapSizes & 0x02) ? 4 : 2;
+
+    if (ibMvidIndex > cbTables || cbMvidIndex > cbTables - ibMvidIndex)
+    {
+        return 0;
+    }
+
+    DWORD iMvid = cbMvidIndex == 4 ?
+        *(const DWORD *)(pbTables + ibMvidIndex) :
+        *(const WORD *)(pbTables + ibMvidIndex);
+
+    if (iMvid == 0 || iMvid > cbGuids / sizeof(GUID))
+    {
+        return 0;
+    }
+
+    return (DWORD)(pbGuids + (iMvid - 1) * sizeof(GUID) - pbImage);
+}
+
+static bool FindVolatileFields
+(
+    const BYTE *pbImage,
+    size_t cbImage,
+    _Out_ PEVolatileFields *pFields
+)
+{
+    memset(pFields, 0, sizeof(*pFields));
+
+    const IMAGE_NT_HEADERS32 *pNtHeaders = (const IMAGE_NT_HEADERS32 *)GetNtHeaders(pbImage, cbImage);
+
+    if (!pNtHeaders)
+    {
+        return false;
+    }
+
+    const IMAGE_DATA_DIRECTORY *rgDirectories;
+    DWORD cDirectories;
+    DWORD ibNtHeaders = (DWORD)((const BYTE *)pNtHeaders - pbImage);
+
+    if (pNtHeaders->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC)
+    {
+        rgDirectories = pNtHeaders->OptionalHeader.DataDirectory;
+        cDirectories = pNtHeaders->OptionalHeader.NumberOfRvaAndSizes;
+        pFields->m_ibCheckSum = ibNtHeaders + offsetof(IMAGE_NT_HEADERS32, OptionalHeader.CheckSum);
+    }
+    else if (pNtHeaders->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+    {
+        const IMAGE_NT_HEADERS64 *pNtHeaders64 = (const IMAGE_NT_HEADERS64 *)pNtHeaders;
+
+        rgDirectories = pNtHeaders64->OptionalHeader.DataDirectory;
+        cDirectories = pNtHeaders64->OptionalHeader.NumberOfRvaAndSizes;
+        pFields->m_ibCheckSum = ibNtHeaders + offsetof(IMAGE_NT_HEADERS64, OptionalHeader.CheckSum);
+    }
+    else
+    {
+        return false;
+    }
+
+    pFields->m_ibTimeStamp = ibNtHeaders + offsetof(IMAGE_NT_HEADERS32, FileHeader.TimeDateStamp);
+
+    DWORD ib;
+
+    // The debug directory.
+    if (cDirectories > IMAGE_DIRECTORY_ENTRY_DEBUG &&
+        rgDirectories[IMAGE_DIRECTORY_ENTRY_DEBUG].Size != 0)
+    {
+        const IMAGE_DATA_DIRECTORY &directory = rgDirectories[IMAGE_DIRECTORY_ENTRY_DEBUG];
+
+        if (!RvaToFileOffset(pNtHeaders, cbImage, directory.VirtualAddress, directory.Size, &ib))
+        {
+            return false;
+        }
+
+        pFields->m_cDebugEntries = (unsigned)min(directory.Size / sizeof(IMAGE_DEBUG_DIRECTORY), (size_t)MAX_DEBUG_DIRECTORY_ENTRIES);
+
+        for (unsigned iEntry = 0; iEntry < pFields->m_cDebugEntries; iEntry++)
+        {
+            DWORD ibEntry = ib + iEntry * sizeof(IMAGE_DEBUG_DIRECTORY);
+            const IMAGE_DEBUG_DIRECTORY *pEntry = (const IMAGE_DEBUG_DIRECTORY *)(pbImage + ibEntry);
+
+            pFields->m_rgibDebugTimeStamp[iEntry] = ibEntry + offsetof(IMAGE_DEBUG_DIRECTORY, TimeDateStamp);
+
+            // A CodeView record is "RSDS", the PDB signature, then the PDB's path.
+            if (pEntry->Type == IMAGE_DEBUG_TYPE_CODEVIEW &&
+                pEntry->SizeOfData >= sizeof(DWORD) + PDB_SIGNATURE_SIZE &&
+                pEntry->PointerToRawData <= cbImage &&
+                cbImage - pEntry->PointerToRawData >= sizeof(DWORD) + PDB_SIGNATURE_SIZE &&
+                *(const DWORD *)(pbImage + pEntry->PointerToRawData) == 0x53445352)
+            {
+                pFields->m_rgibPdbSignature[iEntry] = pEntry->PointerToRawData + sizeof(DWORD);
+                pFields->m_rgcbPdbPath[iEntry] =
+                    (DWORD)(min((size_t)pEntry->SizeOfData, cbImage - pEntry->PointerToRawData) - sizeof(DWORD) - PDB_SIGNATURE_SIZE);
+            }
+        }
+    }
+
+    // The MVID, through the COR header.
+    if (cDirectories > IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR &&
+        RvaToFileOffset(
+            pNtHeaders,
+            cbImage,
+            rgDirectories[IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR].VirtualAddress,
+            sizeof(IMAGE_COR20_HEADER),
+            &ib))
+    {
+        const IMAGE_COR20_HEADER *pCorHeader = (const IMAGE_COR20_HEADER *)(pbImage + ib);
+
+        if (RvaToFileOffset(pNtHeaders, cbImage, pCorHeader->MetaData.VirtualAddress, pCorHeader->MetaData.Size, &ib))
+        {
+            pFields->m_ibMvid = FindMvid(pbImage, ib, pCorHeader->MetaData.Size);
+        }
+    }
+
+    return pFields->m_ibMvid != 0;
+}
+
+// Hashes the image as if the volatile fields were all zero.
+static bool HashImageContent
+(
+    const BYTE *pbImage,
+    size_t cbImage,
+    const PEVolatileFields &fields,
+    _Out_bytecap_(CRYPT_HASHSIZE) void *pvHash
+)
+{
+    struct Range
+    {
+        DWORD m_ib;
+        DWORD m_cb;
+    };
+
+    static const BYTE s_rgbZeros[PDB_SIGNATURE_SIZE] = { 0 };
+
+    Range rgRanges[3 + 2 * MAX_DEBUG_DIRECTORY_ENTRIES];
+    unsigned cRanges = 0;
+
+    rgRanges[cRanges].m_ib = fields.m_ibTimeStamp;
+    rgRanges[cRanges++].m_cb = sizeof(DWORD);
+    rgRanges[cRanges].m_ib = fields.m_ibCheckSum;
+    rgRanges[cRanges++].m_cb = sizeof(DWORD);
+    rgRanges[cRanges].m_ib = fields.m_ibMvid;
+    rgRanges[cRanges++].m_cb = sizeof(GUID);
+
+    for (unsigned iEntry = 0; iEntry < fields.m_cDebugEntries; iEntry++)
+    {
+        rgRanges[cRanges].m_ib = fields.m_rgibDebugTimeStamp[iEntry];
+        rgRanges[cRanges++].m_cb = sizeof(DWORD);
+
+        if (fields.m_rgibPdbSignature[iEntry])
+        {
+            rgRanges[cRanges].m_ib = fields.m_rgibPdbSignature[iEntry];
+            rgRanges[cRanges++].m_cb = PDB_SIGNATURE_SIZE;
+        }
+    }
+
+    // Sort them by offset; there are only a few.
+    for (unsigned i = 1; i < cRanges; i++)
+    {
+        Range range = rgRanges[i];
+        unsigned j = i;
+
+        for (; j > 0 && rgRanges[j - 1].m_ib > range.m_ib; j--)
+        {
+            rgRanges[j] = rgRanges[j - 1];
+        }
+
+        rgRanges[j] = range;
+    }
+
+    CryptHash *psh = NULL;
+    bool fHashed = false;
+
+    if (CryptHash::CreateCryptHashAlgorithm(&psh, CALG_MD5))
+    {
+        size_t ib = 0;
+        fHashed = true;
+
+        for (unsigned i = 0; i < cRanges && fHashed; i++)
+        {
+            VSASSERT(rgRanges[i].m_ib >= ib, "Volatile fields overlap.");
+
+            fHashed =
+                psh->SetCryptHashData(pbImage + ib, rgRanges[i].m_ib - ib) &&
+                psh->SetCryptHashData(s_rgbZeros, rgRanges[i].m_cb);
+
+            ib = rgRanges[i].m_ib + rgRanges[i].m_cb;
+        }
+
+        fHashed = fHashed &&
+            psh->SetCryptHashData(pbImage + ib, cbImage - ib) &&
+            psh->GetCryptHash(pvHash, CRYPT_HASHSIZE);
+
+        psh->Close();
+    }
+
+    return fHashed;
+}
+
+// The standard PE checksum: the 16-bit one's complement sum of the image,
+// checksum field left out, plus the image's length.
+static DWORD ComputeImageCheckSum
+(
+    const BYTE *pbImage,
+    size_t cbImage,
+    DWORD ibCheckSum
+)
+{
+    UINT64 sum = 0;
+
+    for (size_t ib = 0; ib + 1 < cbImage; ib += 2)
+    {
+        if (ib == ibCheckSum || ib == ibCheckSum + 2)
+        {
+            continue;
+        }
+
+        sum += *(const WORD *)(pbImage + ib);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    if (cbImage & 1)
+    {
+        sum += pbImage[cbImage - 1];
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return (DWORD)sum + (DWORD)cbImage;
+}
+
+// The header of an MSF 7.00 file, which is what a PDB is.  The file is made of
+// blocks; the stream directory lists the size of every stream, then the blocks
+// of each stream in turn, and its own blocks are listed in the block at
+// m_iBlockMapBlock.
+struct MsfSuperBlock
+{
+    char m_rgchMagic[32];
+    DWORD m_cbBlock;
+    DWORD m_iFreeBlockMap;
+    DWORD m_cBlocks;
+    DWORD m_cbDirectory;
+    DWORD m_Reserved;
+    DWORD m_iBlockMapBlock;
+};
+
+// The start of stream 1 of a PDB, the PDB info stream.
+struct PdbInfoHeader
+{
+    DWORD m_Version;
+    DWORD m_Signature;
+    DWORD m_Age;
+    GUID m_Guid;
+};
+
+static const char s_rgchMsfMagic[sizeof(((MsfSuperBlock *)0)->m_rgchMagic)] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+
+// Finds the file offset of the PDB info stream header in the PDB mapped at
+// pbPdb.  Returns 0 if the file isn't a PDB we understand.
+static size_t FindPdbInfoHeader
+(
+    const BYTE *pbPdb,
+    size_t cbPdb
+)
+{
+    const MsfSuperBlock *pSuperBlock = (const MsfSuperBlock *)pbPdb;
+
+    if (cbPdb < sizeof(MsfSuperBlock) ||
+        memcmp(pSuperBlock->m_rgchMagic, s_rgchMsfMagic, sizeof(s_rgchMsfMagic)) != 0)
+    {
+        return 0;
+    }
+
+    size_t cbBlock = pSuperBlock->m_cbBlock;
+    size_t cBlocks = min((size_t)pSuperBlock->m_cBlocks, cbPdb / max(cbBlock, (size_t)1));
+    size_t cbDirectory = pSuperBlock->m_cbDirectory;
+
+    // The directory's block list has to fit in the one block.
+    if ((cbBlock != 512 && cbBlock != 1024 && cbBlock != 2048 && cbBlock != 4096) ||
+        pSuperBlock->m_iBlockMapBlock >= cBlocks ||
+        cbDirectory / cbBlock >= cbBlock / sizeof(DWORD))
+    {
+        return 0;
+    }
+
+    const DWORD *rgiDirectoryBlocks = (const DWORD *)(pbPdb + pSuperBlock->m_iBlockMapBlock * cbBlock);
+
+    // Reads the DWORD at ib in the directory.  ib is a multiple of 4, so it
+    // never straddles two blocks.
+    #define MSF_DIRECTORY_DWORD(ib) \
+        (rgiDirectoryBlocks[(ib) / cbBlock] < cBlocks ? \
+            *(const DWORD *)(pbPdb + rgiDirectoryBlocks[(ib) / cbBlock] * cbBlock + (ib) % cbBlock) : \
+            (DWORD)-1)
+
+    if (cbDirectory < 3 * sizeof(DWORD))
+    {
+        return 0;
+    }
+
+    size_t cStreams = MSF_DIRECTORY_DWORD(0);
+    DWORD cbStream0 = MSF_DIRECTORY_DWORD(sizeof(DWORD));
+    DWORD cbStream1 = MSF_DIRECTORY_DWORD(2 * sizeof(DWORD));
+
+    // A deleted stream has a size of -1 and no blocks.
+    size_t cStream0Blocks = cbStream0 == (DWORD)-1 ? 0 : (cbStream0 + cbBlock - 1) / cbBlock;
+    size_t ibStream1Blocks = (1 + cStreams + cStream0Blocks) * sizeof(DWORD);
+
+    if (cStreams < 2 ||
+        cStreams > cbDirectory ||
+        cbStream1 == (DWORD)-1 ||
+        cbStream1 < sizeof(PdbInfoHeader) ||
+        ibStream1Blocks > cbDirectory - sizeof(DWORD))
+    {
+        return 0;
+    }
+
+    DWORD iStream1Block = MSF_DIRECTORY_DWORD(ibStream1Blocks);
+
+    #undef MSF_DIRECTORY_DWORD
+
+    if (iStream1Block >= cBlocks)
+    {
+        return 0;
+    }
+
+    return iStream1Block * cbBlock;
+}
+
+// Gives the PDB in wszPdbFileName the GUID Guid and the signature
+// Signature.  Sets *pfStamped to false,
+// and leaves the file alone, if it isn't a PDB we understand.
+static HRESULT StampPdbGuid
+(
+    _In_z_ const WCHAR *wszPdbFileName,
+    const GUID &Guid,
+    DWORD Signature,
+    _Out_ bool *pfStamped
+)
+{
+    HRESULT hr = NOERROR;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapFile = NULL;
+    BYTE *pbPdb = NULL;
+    DWORD cbPdb = 0;
+    size_t ibInfoHeader = 0;
+
+    *pfStamped = false;
+
+    hFile = CreateFileW(wszPdbFileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    IfTrueGoLast(hFile == INVALID_HANDLE_VALUE);
+
+    cbPdb = GetFileSize(hFile, NULL);
+    IfTrueGoLast(cbPdb == INVALID_FILE_SIZE);
+
+    hMapFile = CreateFileMapping(hFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+    IfFalseGoLast(hMapFile);
+
+    pbPdb = (BYTE *)MapViewOfFile(hMapFile, FILE_MAP_WRITE, 0, 0, 0);
+    IfFalseGoLast(pbPdb);
+
+    ibInfoHeader = FindPdbInfoHeader(pbPdb, cbPdb);
+
+    if (ibInfoHeader)
+    {
+        PdbInfoHeader *pInfoHeader = (PdbInfoHeader *)(pbPdb + ibInfoHeader);
+
+        pInfoHeader->m_Signature = Signature;
+        pInfoHeader->m_Guid = Guid;
+        *pfStamped = true;
+    }
+
+Error:
+
+    if (pbPdb)
+    {
+        UnmapViewOfFile(pbPdb);
+    }
+
+    if (hMapFile)
+    {
+        CloseHandle(hMapFile);
+    }
+
+    if (hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hFile);
+    }
+
+    return hr;
+}
+
+// Gives the PDB named in the CodeView record whose signature is at
+// ibPdbSignature the GUID Guid, and then the record too.  The PDB's own
+// signature, which the record doesn't hold, becomes TimeStamp.  Nothing
+// changes if the PDB can't be stamped.
+void PEBuilder::StampPdbSignature
+(
+    _Inout_ BYTE *pbImage,
+    DWORD ibPdbSignature,
+    DWORD cbPdbPath,
+    const GUID &Guid,
+    DWORD TimeStamp
+)
+{
+    if (m_pCompilerProject->GetPDBStream())
+    {
+        return;
+    }
+
+    // The record's path is null terminated UTF-8.
+    const char *szPdbPath = (const char *)(pbImage + ibPdbSignature + PDB_SIGNATURE_SIZE);
+    int cchPdbPath = (int)strnlen(szPdbPath, cbPdbPath);
+    int cchWide = cchPdbPath ? MultiByteToWideChar(CP_UTF8, 0, szPdbPath, cchPdbPath, NULL, 0) : 0;
+
+    if (cchWide == 0)
+    {
+        return;
+    }
+
+    NorlsAllocator nraScratch(NORLSLOC);
+    WCHAR *wszPdbFileName = (WCHAR *)nraScratch.Alloc(VBMath::Multiply(VBMath::Add(cchWide, 1), sizeof(WCHAR)));
+
+    MultiByteToWideChar(CP_UTF8, 0, szPdbPath, cchPdbPath, wszPdbFileName, cchWide);
+    wszPdbFileName[cchWide] = 0;
+
+    bool fStamped = false;
+    HRESULT hr = StampPdbGuid(wszPdbFileName, Guid, TimeStamp, &fStamped);
+
+    if (FAILED(hr))
+    {
+        m_pErrorTable->CreateErrorWithError(ERRID_BadOutputFile1, NULL, hr, wszPdbFileName);
+    }
+    else if (fStamped)
+    {
+        memcpy(pbImage + ibPdbSignature, &Guid, sizeof(GUID));
+    }
+}
+
+bool PEBuilder::GetImageContentHash(_Out_bytecap_(CRYPT_HASHSIZE) void *pvHash)
+{
+    if (m_fHasImageContentHash)
+    {
+        memcpy(pvHash, m_rgbImageContentHash, CRYPT_HASHSIZE);
+    }
+
+    return m_fHasImageContentHash;
+}
+
+void PEBuilder::StampDeterministicImage
+(
+    _In_opt_ BYTE *pbImage,
+    _In_opt_z_ STRING *pstrFileName
+)
+{
+    VSASSERT(pbImage || pstrFileName, "Nothing to stamp.");
+
+    HRESULT hr = NOERROR;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapFile = NULL;
+    size_t cbImage = 0;
+    PEVolatileFields fields;
+
+    if (pbImage)
+    {
+        cbImage = GetMemoryImageSize(pbImage);
+    }
+    else
+    {
+        // Map the file we just wrote and stamp it in place.
+        DWORD cbFile = 0;
+
+        hFile = CreateFileW(pstrFileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        IfTrueGoLast(hFile == INVALID_HANDLE_VALUE);
+
+        cbFile = GetFileSize(hFile, NULL);
+        IfTrueGoLast(cbFile == INVALID_FILE_SIZE);
+
+        hMapFile = CreateFileMapping(hFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+        IfFalseGoLast(hMapFile);
+
+        pbImage = (BYTE *)MapViewOfFile(hMapFile, FILE_MAP_WRITE, 0, 0, 0);
+        IfFalseGoLast(pbImage);
+
+        cbImage = cbFile;
+    }
+
+    if (!FindVolatileFields(pbImage, cbImage, &fields))
+    {
+        VSFAIL("Can't find the volatile fields of the PE we just generated.");
+        goto Error;
+    }
+
+    if (!HashImageContent(pbImage, cbImage, fields, m_rgbImageContentHash))
+    {
+        IfFailGo(GetLastHResultError());
+    }
+
+    m_fHasImageContentHash = true;
+
+    {
+        // A time stamp with the high bit set can't be mistaken for a real one.
+        DWORD TimeStamp = *(DWORD *)m_rgbImageContentHash | 0x80000000;
+        GUID Mvid;
+
+        // Make the MVID a well-formed (version 4, RFC 4122) GUID.
+        memcpy(&Mvid, m_rgbImageContentHash, sizeof(GUID));
+        Mvid.Data3 = (Mvid.Data3 & 0x0FFF) | 0x4000;
+        Mvid.Data4[0] = (Mvid.Data4[0] & 0x3F) | 0x80;
+
+        *(DWORD *)(pbImage + fields.m_ibTimeStamp) = TimeStamp;
+        memcpy(pbImage + fields.m_ibMvid, &Mvid, sizeof(GUID));
+
+        for (unsigned iEntry = 0; iEntry < fields.m_cDebugEntries; iEntry++)
+        {
+            *(DWORD *)(pbImage + fields.m_rgibDebugTimeStamp[iEntry]) = TimeStamp;
+
+            if (fields.m_rgibPdbSignature[iEntry])
+            {
+                StampPdbSignature(pbImage, fields.m_rgibPdbSignature[iEntry], fields.m_rgcbPdbPath[iEntry], Mvid, TimeStamp);
+            }
+        }
+
+        if (*(DWORD *)(pbImage + fields.m_ibCheckSum) != 0)
+        {
+            *(DWORD *)(pbImage + fields.m_ibCheckSum) = ComputeImageCheckSum(pbImage, cbImage, fields.m_ibCheckSum);
+        }
+    }
+
+Error:
+
+    if (hFile != INVALID_HANDLE_VALUE)
+    {
+        if (pbImage)
+        {
+            UnmapViewOfFile(pbImage);
+        }
+
+        if (hMapFile)
+        {
+            CloseHandle(hMapFile);
+        }
+
+        CloseHandle(hFile);
+    }
+
+    if (FAILED(hr))
+    {
+        if (pstrFileName)
+        {
+            m_pErrorTable->CreateErrorWithError(ERRID_BadOutputFile1, NULL, hr, pstrFileName);
+        }
+        else
+        {
+            VbThrow(hr);
+        }
+    }
+}
+
+void PEBuilder::WriteImageContentHash(_In_z_ STRING *pstrHashFileName)
+{
+    BYTE rgbHash[CRYPT_HASHSIZE];
+
+    if (!GetImageContentHash(rgbHash))
+    {
+        // StampDeterministicImage has already reported why.
+        return;
+    }
+
+    static const char s_rgchHexDigits[] = "0123456789abcdef";
+    char rgchHash[CRYPT_HASHSIZE * 2 + 2];
+
+    for (unsigned ib = 0; ib < CRYPT_HASHSIZE; ib++)
+    {
+        rgchHash[ib * 2] = s_rgchHexDigits[rgbHash[ib] >> 4];
+        rgchHash[ib * 2 + 1] = s_rgchHexDigits[rgbHash[ib] & 0xF];
+    }
+
+    rgchHash[CRYPT_HASHSIZE * 2] = '\r';
+    rgchHash[CRYPT_HASHSIZE * 2 + 1] = '\n';
+
+    HRESULT hr = NOERROR;
+    DWORD cbWritten = 0;
+    HANDLE hFile = CreateFileW(pstrHashFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE ||
+        !WriteFile(hFile, rgchHash, sizeof(rgchHash), &cbWritten, NULL))
+    {
+        hr = GetLastHResultError();
+    }
+
+    if (hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hFile);
+    }
+
+    if (FAILED(hr))
+    {
+        m_pErrorTable->CreateErrorWithError(ERRID_BadOutputFile1, NULL, hr, pstrHashFileName);
+    }
+}
+
 #if IDE 
 
 //============================================================================
@@ -55,6 +55,39 @@ struct CodeGenInfo
     CodeGenInfo(ILTree::ILNode * pBoundTree, BCSYM_Proc * pProc, SourceFile * pSourceFile);
 };
 
+#if !IDE
+//=============================================================================
+// The method bodies of one container, parsed on several threads ahead of
+// PEBuilder::GenerateBoundTreesForContainer.  The parse errors of each body
+// are held in a temporary error table until the body is bound, so that the
+// errors of a file come out in the same order as when parsing as we go.
+//=============================================================================
+
+struct PreparsedMethodBody
+{
+    BCSYM_Proc * m_pProc;
+    ErrorTable * m_pErrors;
+    ParseTree::MethodBodyStatement * m_pTree;
+    HRESULT m_hr;
+};
+
+class PreparsedMethodBodies
+{
+public:
+    PreparsedMethodBodies();
+    ~PreparsedMethodBodies();
+
+    // Returns the body of pProc if it was preparsed.  Each body is taken once.
+    PreparsedMethodBody * Take(BCSYM_Proc * pProc);
+
+    SourceFile * m_pSourceFile;
+    Text * m_pText;                                         // shared by all the threads
+    DynamicArray<PreparsedMethodBody> m_daBodies;
+    DynamicHashTable<BCSYM_Proc *, ULONG> m_BodyIndex;      // index into m_daBodies
+    NorlsAllocator * m_rgpnraTrees[MAXIMUM_WAIT_OBJECTS];   // one per thread
+};
+#endif !IDE
+
 struct PDBForwardProcCacheNode : public RedBlackNodeBaseT<BCSYM_Namespace*>
 {
     BCSYM_Proc *m_pForwardProc;
@@ -301,6 +334,7 @@ public:
     PEBuilder(Compiler *pCompiler, CompilerProject *pProject) : Builder(pCompiler, pProject)
     {
         m_BuilderType = BuilderType_PEBuilder;
+        m_fHasImageContentHash = false;
 
 #if IDE 
         ImageOnDiskIsNotUpToDate();
@@ -325,6 +359,10 @@ public:
 
     bool Compile(CompileType type, _Out_ bool *pfGeneratedOutput, ErrorTable *pErrorTable, BYTE **ppImage);
 
+    // Gets the content hash of the last PE written with deterministic output
+    // on.  Returns false if there isn't one.
+    bool GetImageContentHash(_Out_bytecap_(CRYPT_HASHSIZE) void *pvHash);
+
 #if IDE 
     SourceFile * OptimizeFileCompilationList(DynamicHashTable<CompilerFile *, bool> & filesToPrefer);
 
@@ -471,6 +509,17 @@ private:
                                  NorlsAllocator * pNraBoundTrees,
                                  _Inout_ DynamicArray<CodeGenInfo>* pCodeGenInfos);
 
+#if !IDE
+    // Parse the bodies of the methods in this container on several threads.
+    // GenerateBoundTreeForProc picks them up through m_pPreparsedMethodBodies.
+    //
+    void PreparseMethodBodies(BCSYM_Container *pContainer,
+                              Text *pText,
+                              _Out_ PreparsedMethodBodies *pPreparsed);
+
+    static void PreparseMethodBodyWorkItem(void *pvPreparsed, unsigned iThread, long iBody);
+#endif !IDE
+
     // Emit custom attributes attached to this proc and its params.
     //
     void EmitAttributesOnProcAndParams(BCSYM_Proc *pproc, _Inout_ MetaEmit *metaemitHelper, bool isNoPIaEmbeddedSymbol);
@@ -498,6 +547,16 @@ private:
 
     void WriteDllCharacteristics(PEInfo *pInfo, WORD DllCharacteristics);
 
+    // Hashes the PE just generated, to memory (pbImage) or to disk, and
+    // stamps its time stamps, MVID and PDB signature from the hash.
+    void StampDeterministicImage(_In_opt_ BYTE *pbImage, _In_opt_z_ STRING *pstrFileName);
+
+    // Gives the PDB named by a CodeView record, and the record, a GUID.
+    void StampPdbSignature(_Inout_ BYTE *pbImage, DWORD ibPdbSignature, DWORD cbPdbPath, const GUID &Guid, DWORD TimeStamp);
+
+    // Writes the hash of the PE just stamped to the file named by /contenthash.
+    void WriteImageContentHash(_In_z_ STRING *pstrHashFileName);
+
     // Write the code block for this proc to the PE generator.
     void EmitAllCodeBlocksForProc(BCSYM_Proc *pProc, PEInfo *pInfo);
 
@@ -638,6 +697,12 @@ private:
     // Symbols created during method body compilation
     TransientSymbolStore m_Transients;
 
+#if !IDE
+    // Method bodies of the container being compiled that were parsed ahead
+    // of time, or NULL.
+    PreparsedMethodBodies *m_pPreparsedMethodBodies;
+#endif
+
     // Methods which should have PDB information.  This includes Lambdas
     // and Resumable methods (Async/Iterators)
     std::map<SourceFile*, std::vector<BCSYM_SyntheticMethod*> > m_SyntheticMethods;
@@ -651,4 +716,8 @@ private:
 #endif
 
     DynamicHashTable<STRING*, ISymUnmanagedDocumentWriter*> m_pdbDocs;
+
+    // Content hash of the last PE written with deterministic output on.
+    BYTE m_rgbImageContentHash[CRYPT_HASHSIZE];
+    bool m_fHasImageContentHash;
 };
@@ -0,0 +1,27 @@
+// ==++==
+//
+//   Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+// ==--==
+// ===========================================================================
+// File: timercounters.h
+//
+// Defined the timer counters. Each counter is a running total (of hits,
+// bytes, ...) that is reported along with the timed sections.
+//
+// The columns represent:
+//   ID used to represent the counter programmatically
+//   name used to output the counter
+// ===========================================================================
+
+TIMERCOUNTER(COUNT_KeywordTableHits,                "KeywordTableHits")
+TIMERCOUNTER(COUNT_MethodBodyCacheHits,             "MethodBodyCacheHits")
+TIMERCOUNTER(COUNT_MethodBodyCacheMisses,           "MethodBodyCacheMisses")
+TIMERCOUNTER(COUNT_MethodBodyCacheBytesHeld,        "MethodBodyCacheBytesHeld")
+TIMERCOUNTER(COUNT_DeclTreeBytesCommitted,          "DeclTreeBytesCommitted")
+TIMERCOUNTER(COUNT_ConversionCacheHits,             "ConversionCacheHits")
+TIMERCOUNTER(COUNT_ConversionCacheMisses,           "ConversionCacheMisses")
+TIMERCOUNTER(COUNT_OverloadArityCacheHits,          "OverloadArityCacheHits")
+TIMERCOUNTER(COUNT_OverloadArityCacheMisses,        "OverloadArityCacheMisses")
+TIMERCOUNTER(COUNT_DefAsgReEvals,                   "DefAsgReEvals")
+TIMERCOUNTER(COUNT_ExtensionMethodImportSetHits,    "ExtensionMethodImportSetHits")
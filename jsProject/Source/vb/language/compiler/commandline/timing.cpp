@@ -24,6 +24,7 @@
 // to be very low overhead if it's not in use.
 
 bool g_isTimingActive = false;
+DWORD g_timingThreadId;         // The only thread whose sections are timed.
 
 LARGE_INTEGER g_qpcStartTime;  // In units returns by QueryPerformanceCounter
 LARGE_INTEGER g_qpcStopTime;
@@ -31,6 +32,7 @@ LARGE_INTEGER g_qpcStopTime;
 __int64 g_startTime;            // In units returned by GetTickCountrTick
 __int64 g_lastTime;
 __int64 g_stopTime;
+__int64 g_lastCpuTime;          // In 100ns units, see GetThreadCpuTime
 TIMERID g_timeridStack[1000];
 int g_timeridStackPtr; // points to top USED value on stack, or -1 if stack is empty.
 
@@ -44,9 +46,11 @@ struct TIMERSECTIONDATA
 {
     unsigned totalCount;
     __int64 totalTime;
+    __int64 cpuTime;            // In 100ns units, including time charged by other threads.
 };
 
 TIMERSECTIONDATA g_timerData[TIMERID_MAX];
+volatile __int64 g_counterData[TIMERCOUNTER_MAX];
 
 #define TIMER_GROUP(cat, name)
 #define TIMERID(id, text, subtotal) { L##text, subtotal} ,
@@ -57,6 +61,13 @@ const TIMERSECTIONINFO g_timerInfo[TIMERID_MAX] =
 #undef TIMERID
 #undef TIMER_GROUP
 
+#define TIMERCOUNTER(id, text) L##text,
+const PCWSTR g_counterNames[TIMERCOUNTER_MAX] =
+    {
+#include "timercounters.h"
+    };
+#undef TIMERCOUNTER
+
 struct TimerGroupName
 {
     int m_group_id;
@@ -119,6 +130,24 @@ __int64 GetCurrentTimerTickM()
     return GetCurrentTimerTick();
 }
 
+__int64 GetThreadCpuTime(HANDLE hThread)
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if (!GetThreadTimes(hThread, &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        return 0;
+    }
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    return (__int64)(kernel.QuadPart + user.QuadPart);
+}
+
 /*
  * Start the timing and reset all timer counts.
  */
@@ -129,9 +158,17 @@ void ActivateTiming()
     {
         g_timerData[id].totalCount = 0;
         g_timerData[id].totalTime = 0;
+        g_timerData[id].cpuTime = 0;
+    }
+
+    for (TIMERCOUNTERID id = (TIMERCOUNTERID) 0; id < TIMERCOUNTER_MAX; id = (TIMERCOUNTERID) (id + 1))
+    {
+        g_counterData[id] = 0;
     }
 
     InitializeTimerTick();
+    g_timingThreadId = GetCurrentThreadId();
+    g_lastCpuTime = GetThreadCpuTime(GetCurrentThread());
     g_stopTime = 0;
     g_timeridStackPtr = -1;
     g_isTimingActive = true;
@@ -163,7 +200,13 @@ void FinishTiming()
  */
 void DoTimerStart(TIMERID timerId)
 {
+    if (GetCurrentThreadId() != g_timingThreadId)
+    {
+        return;
+    }
+
     __int64 now = GetCurrentTimerTick();
+    __int64 cpuNow = GetThreadCpuTime(GetCurrentThread());
     int stackPtr = g_timeridStackPtr;
     TIMERID oldId;
 
@@ -172,6 +215,7 @@ void DoTimerStart(TIMERID timerId)
     {
         oldId = g_timeridStack[stackPtr];
         g_timerData[oldId].totalTime += (now - g_lastTime);
+        g_timerData[oldId].cpuTime += (cpuNow - g_lastCpuTime);
     }
 
     // update the stack
@@ -199,6 +243,7 @@ void DoTimerStart(TIMERID timerId)
     // update the count and remember when we started.
     ++g_timerData[timerId].totalCount;
     g_lastTime = now;
+    g_lastCpuTime = cpuNow;
 }
 
 
@@ -207,7 +252,13 @@ void DoTimerStart(TIMERID timerId)
  */
 void DoTimerStop(TIMERID timerId)
 {
+    if (GetCurrentThreadId() != g_timingThreadId)
+    {
+        return;
+    }
+
     __int64 now = GetCurrentTimerTick();
+    __int64 cpuNow = GetThreadCpuTime(GetCurrentThread());
     int stackPtr = g_timeridStackPtr;
 
     // Pop the stack. If the id doesn't match, pop until it does (exception thrown, maybe?)
@@ -220,10 +271,34 @@ void DoTimerStop(TIMERID timerId)
 
     // Record the amount of time so far in the current section, if any.
     g_timerData[timerId].totalTime += (now - g_lastTime);
+    g_timerData[timerId].cpuTime += (cpuNow - g_lastCpuTime);
     g_timeridStackPtr = stackPtr;
 
     // remember the new time
     g_lastTime = now;
+    g_lastCpuTime = cpuNow;
+}
+
+/*
+ * Charge the CPU time of a helper thread to a section. Must be called on the
+ * timing thread, typically after joining the helper.
+ */
+void DoTimerAddCpuTime(TIMERID timerId, __int64 cpuTime)
+{
+    if (GetCurrentThreadId() != g_timingThreadId)
+    {
+        return;
+    }
+
+    g_timerData[timerId].cpuTime += cpuTime;
+}
+
+/*
+ * Add to a counter. May be called on any thread.
+ */
+void DoTimerAddCount(TIMERCOUNTERID counterId, __int64 value)
+{
+    InterlockedExchangeAdd64(&g_counterData[counterId], value);
 }
 
 #ifndef CSEE
@@ -333,20 +408,22 @@ void ReportTimes(FILE * outputFile)
     __int64 total;
 
     fwprintf(outputFile, L"All times are mutually exclusive. Total compile time: %.1f ms.\n", elapsedTimeMsec);
+    fwprintf(outputFile, L"Time %% is wall clock time on the main thread; CPU ms includes helper threads.\n");
     fwprintf(outputFile, L"\n");
 
     subTotal = 0;
     total = 0;
 
-    fwprintf(outputFile, L"%-50s  %10s  %7s\n", L"Name of code section", L"Hits", L"  Time %");
-    fwprintf(outputFile, L"==========================================================================\n");
+    fwprintf(outputFile, L"%-50s  %10s  %7s  %10s\n", L"Name of code section", L"Hits", L"  Time %", L"CPU ms");
+    fwprintf(outputFile, L"======================================================================================\n");
     for (TIMERID id = (TIMERID)0; id < TIMERID_MAX; id = (TIMERID) (id + 1))
     {
         if (g_timerData[id].totalCount != 0)
         {
-            fwprintf(outputFile, L"%-50s  %10d  %7.3f%%\n", g_timerInfo[id].name,
+            fwprintf(outputFile, L"%-50s  %10d  %7.3f%%  %10.1f\n", g_timerInfo[id].name,
                      g_timerData[id].totalCount,
-                     (double) g_timerData[id].totalTime / elapsedTime * 100.0);
+                     (double) g_timerData[id].totalTime / elapsedTime * 100.0,
+                     (double) g_timerData[id].cpuTime / 10000.0);
         }
 
         subTotal += g_timerData[id].totalTime;
@@ -358,7 +435,7 @@ void ReportTimes(FILE * outputFile)
             // print subtotal
             if (subTotal > 0)
             {
-                fwprintf(outputFile, L"--------------------------------------------------------------------------\n");
+                fwprintf(outputFile, L"--------------------------------------------------------------------------------------\n");
                 fwprintf(outputFile, L"%-50s  %10s  %7.3f%%\n\n", L"SUBTOTAL", L"",
                          (double) subTotal / elapsedTime * 100.0);
             }
@@ -368,9 +445,26 @@ void ReportTimes(FILE * outputFile)
     }
 
     // print total
-    fwprintf(outputFile, L"--------------------------------------------------------------------------\n");
+    fwprintf(outputFile, L"--------------------------------------------------------------------------------------\n");
     fwprintf(outputFile, L"%-50s  %10s  %7.3f%%\n\n", L"TOTAL OF TIMED SECTIONS", L"",
              (double) total / elapsedTime * 100.0);
+
+    // print the counters that were used
+    bool countersStarted = false;
+    for (TIMERCOUNTERID id = (TIMERCOUNTERID)0; id < TIMERCOUNTER_MAX; id = (TIMERCOUNTERID) (id + 1))
+    {
+        if (g_counterData[id] != 0)
+        {
+            if (!countersStarted)
+            {
+                countersStarted = true;
+                fwprintf(outputFile, L"%-50s  %20s\n", L"Name of counter", L"Value");
+                fwprintf(outputFile, L"======================================================================================\n");
+            }
+
+            fwprintf(outputFile, L"%-50s  %20I64d\n", g_counterNames[id], g_counterData[id]);
+        }
+    }
 }
 #endif
 
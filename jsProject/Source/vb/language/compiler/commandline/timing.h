@@ -27,6 +27,13 @@ enum TIMERID {
 #undef TIMERID
 #undef TIMER_GROUP
 
+// Create the TIMERCOUNTERID enum. To add a new counter, edit the timercounters.h file.
+#define TIMERCOUNTER(id, text) id,
+enum TIMERCOUNTERID {
+#include "timercounters.h"
+    TIMERCOUNTER_MAX
+};
+#undef TIMERCOUNTER
 
 
 // Although it is verboten in most parts of the compiler, we use static
@@ -35,6 +42,10 @@ enum TIMERID {
 // this is an internal debugging tool anyway, that's OK for this
 // one specific thing. It's important to be static because we want this
 // to be very low overhead if it's not in use.
+//
+// Sections are only timed on the thread that called ActivateTiming. Work
+// farmed out to other threads is accounted for by adding the CPU time of
+// those threads to the section that waited for them (TimerAddCpuTime).
 
 
 // Is timing on?
@@ -45,6 +56,11 @@ extern void ActivateTiming();
 extern void FinishTiming();
 extern void DoTimerStart(TIMERID timerId);
 extern void DoTimerStop(TIMERID timerId);
+extern void DoTimerAddCpuTime(TIMERID timerId, __int64 cpuTime);
+extern void DoTimerAddCount(TIMERCOUNTERID counterId, __int64 value);
+
+// User plus kernel time of a thread, in 100ns units.
+extern __int64 GetThreadCpuTime(HANDLE hThread);
 
 // Begin timing something.
 __forceinline void TimerStart(TIMERID timerId)
@@ -60,6 +76,20 @@ __forceinline void TimerStop(TIMERID timerId)
         DoTimerStop(timerId);
 }
 
+// Charge CPU time (in 100ns units) used by another thread to a section.
+__forceinline void TimerAddCpuTime(TIMERID timerId, __int64 cpuTime)
+{
+    if (g_isTimingActive)
+        DoTimerAddCpuTime(timerId, cpuTime);
+}
+
+// Add to a counter. Unlike sections, counters may be updated on any thread.
+__forceinline void TimerAddCount(TIMERCOUNTERID counterId, __int64 value)
+{
+    if (g_isTimingActive)
+        DoTimerAddCount(counterId, value);
+}
+
 // class to time a block of code
 class TIMERBLOCK
 {
@@ -78,8 +108,10 @@ private:
 
 #if IDE || IDE64
 #define TIMEBLOCK(timerId) 
+#define TIMERCOUNT(counterId, value)
 #else
 #define TIMEBLOCK(timerId) TIMERBLOCK __timerId(timerId)
+#define TIMERCOUNT(counterId, value) TimerAddCount(counterId, value)
 #endif
 
 #ifndef CSEE 
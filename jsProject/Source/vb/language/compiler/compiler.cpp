@@ -1809,6 +1809,99 @@ Error:
     RRETURN( hr );
 }
 
+#if !IDE
+
+//============================================================================
+// Assign each project a dependency level: one more than the highest level of
+// the projects it references.  rgpProjects is in dependency order, so the
+// referenced projects have their levels already.  Projects of the same level
+// don't depend on each other.  Returns the number of levels.
+//============================================================================
+
+static unsigned ComputeProjectLevels
+(
+    CompilerProject **rgpProjects,
+    unsigned cProjects,
+    _Out_ DynamicArray<unsigned> *pdaLevels
+)
+{
+    DynamicHashTable<CompilerProject *, unsigned> levels;
+    unsigned cLevels = 0;
+
+    for (unsigned iProject = 0; iProject < cProjects; iProject++)
+    {
+        unsigned level = 0;
+        unsigned referencedLevel;
+        ReferenceIterator refs(rgpProjects[iProject]);
+
+        while (CompilerProject *pReferencedProject = refs.Next())
+        {
+            if (levels.GetValue(pReferencedProject, &referencedLevel))
+            {
+                level = max(level, referencedLevel + 1);
+            }
+        }
+
+        levels.SetValue(rgpProjects[iProject], level);
+        pdaLevels->AddElement(level);
+        cLevels = max(cLevels, level + 1);
+    }
+
+    return cLevels;
+}
+
+//============================================================================
+// Parse the declarations of all the projects of one level together, so that
+// a level of many small projects still keeps every parse thread busy.
+//============================================================================
+
+static void ParseDeclTreesOfLevel
+(
+    CompilerProject **rgpProjects,
+    unsigned cProjects,
+    DynamicArray<unsigned> *pdaLevels,
+    unsigned level
+)
+{
+    DynamicArray<CompilerProject *> daProjectsInLevel;
+
+    for (unsigned iProject = 0; iProject < cProjects; iProject++)
+    {
+        if (pdaLevels->Element(iProject) == level)
+        {
+            daProjectsInLevel.AddElement(rgpProjects[iProject]);
+        }
+    }
+
+    CompilerProject::ParseDeclTreesInParallel(daProjectsInLevel.Array(), daProjectsInLevel.Count());
+}
+
+//============================================================================
+// Per project progress is reported through the host when the
+// VBC_PROJECT_PROGRESS environment variable is set.
+//============================================================================
+
+static bool IsProjectProgressRequested()
+{
+    const LPCWSTR wszEnvironmentVar = L"VBC_PROJECT_PROGRESS";
+    return GetEnvironmentVariableW(wszEnvironmentVar, NULL, 0) != 0;
+}
+
+static void ReportProjectProgress
+(
+    CompilerHost *pCompilerHost,
+    CompilerProject *pProject,
+    _In_z_ const WCHAR *wszState,
+    unsigned level
+)
+{
+    STRING *pstrName = pProject->GetAssemblyName();
+
+    pCompilerHost->Printf(L"%s: %s (level %u)\n", pstrName ? pstrName : L"", wszState, level);
+}
+
+#endif !IDE
+
 //============================================================================
 // Compile all loaded projects.
 //============================================================================
@@ -1866,16 +1959,57 @@ STDMETHODIMP Compiler::Compile
             VSASSERT(rgpProjects[0] == pCurrentCompilerHost->GetComPlusProject(), "Project compilation list order wrong!!!");
         }
 
+#if !IDE
+        // Group the projects by dependency level.  The steps below still
+        // run one project at a time in list order because they share the
+        // compiler's symbol tables, but the declarations of a whole level
+        // are parsed together as soon as the first project of the level
+        // is reached.
+        DynamicArray<unsigned> daLevels;
+        DynamicArray<bool> daLevelParsed;
+        unsigned cLevels = ComputeProjectLevels(rgpProjects, cProjects, &daLevels);
+        bool fReportProgress = IsProjectProgressRequested();
+
+        for (unsigned iLevel = 0; iLevel < cLevels; iLevel++)
+        {
+            daLevelParsed.AddElement(false);
+        }
+#endif !IDE
+
         // Build the symbol table for all projects.
         for (iProject = 1; iProject < cProjects; iProject++)
         {
+#if !IDE
+            unsigned level = daLevels.Element(iProject);
+
+            if (!daLevelParsed.Element(level))
+            {
+                daLevelParsed.Element(level) = true;
+                ParseDeclTreesOfLevel(rgpProjects, cProjects, &daLevels, level);
+            }
+#endif !IDE
+
             IfTrueGo(rgpProjects[iProject]->CompileToDeclared(), E_FAIL);
+
+#if !IDE
+            if (fReportProgress)
+            {
+                ReportProjectProgress(pCurrentCompilerHost, rgpProjects[iProject], L"declared", level);
+            }
+#endif !IDE
         }
 
         // Bind the symbols
         for (iProject = 1; iProject < cProjects; iProject++)
         {
             IfTrueGo(rgpProjects[iProject]->CompileFromDeclaredToBound(), E_FAIL);
+
+#if !IDE
+            if (fReportProgress)
+            {
+                ReportProjectProgress(pCurrentCompilerHost, rgpProjects[iProject], L"bound", daLevels.Element(iProject));
+            }
+#endif !IDE
         }
 
         // Compile method bodies
@@ -1887,6 +2021,13 @@ STDMETHODIMP Compiler::Compile
             {
                 fHasErrors = true;
             }
+
+#if !IDE
+            if (fReportProgress)
+            {
+                ReportProjectProgress(pCurrentCompilerHost, rgpProjects[iProject], L"compiled", daLevels.Element(iProject));
+            }
+#endif !IDE
         }
 
         // Clear the error cache
@@ -1909,6 +2050,8 @@ STDMETHODIMP Compiler::Compile
     VB_EXIT_NORETURN();
 
 Error:
+    NorlsAllocProfiler::WriteReportIfRequested();
+
     // We want to report any errors even if the compilation failed
     if (pcErrors)
     {
@@ -137,6 +137,190 @@ void LiftedUserDefinedOperatorCache::NodeOperations::copy(
     pNodeDest->pLiftedOperator = pNodeSrc->pLiftedOperator;
 }
 
+ConversionClassificationCache::ConversionClassificationCache(NorlsAllocator * pNorls) :
+    m_cache(pNorls)
+{
+    ThrowIfNull(pNorls);
+}
+
+bool
+ConversionClassificationCache::LookupInCache
+(
+    BCSYM * pTargetType,
+    BCSYM * pSourceType,
+    bool considerConversionsOnNullableBool,
+    bool IgnoreOperatorMethod,
+    Classification * pCacheValue                    //[out] - the cached classification
+)
+{
+    Node * pNode = NULL;
+
+    if
+    (
+        m_cache.Find(&Key(pTargetType, pSourceType, considerConversionsOnNullableBool, IgnoreOperatorMethod), &pNode)
+    )
+    {
+        TIMERCOUNT(COUNT_ConversionCacheHits, 1);
+        *pCacheValue = pNode->Value;
+        return true;
+    }
+    else
+    {
+        TIMERCOUNT(COUNT_ConversionCacheMisses, 1);
+        return false;
+    }
+}
+
+void
+ConversionClassificationCache::AddEntry
+(
+    BCSYM * pTargetType,
+    BCSYM * pSourceType,
+    bool considerConversionsOnNullableBool,
+    bool IgnoreOperatorMethod,
+    const Classification & CacheValue
+)
+{
+    Node * pNode = NULL;
+
+    m_cache.Insert(&Key(pTargetType, pSourceType, considerConversionsOnNullableBool, IgnoreOperatorMethod), &pNode);
+    pNode->Value = CacheValue;
+}
+
+void ConversionClassificationCache::Clear()
+{
+    m_cache.Clear();
+}
+
+ConversionClassificationCache::Key::Key()
+{
+    memset(this, 0, sizeof(Key));
+}
+
+ConversionClassificationCache::Key::Key
+(
+    BCSYM * pTargetType,
+    BCSYM * pSourceType,
+    bool considerConversionsOnNullableBool,
+    bool IgnoreOperatorMethod
+)
+{
+    memset(this, 0, sizeof(Key));
+    this->pTargetType = pTargetType;
+    this->pSourceType = pSourceType;
+    this->Flags = BoolToInt(considerConversionsOnNullableBool) | (BoolToInt(IgnoreOperatorMethod) << 1);
+}
+
+int ConversionClassificationCache::KeyOperations::compare(
+    const Key * pKey1,
+    const Key * pKey2)
+{
+    return memcmp(pKey1, pKey2, sizeof(Key));
+}
+
+void ConversionClassificationCache::NodeOperations::copy(
+    Node * pNodeDest,
+    const Node * pNodeSrc)
+{
+    pNodeDest->Value = pNodeSrc->Value;
+}
+
+OverloadArityCache::OverloadArityCache(NorlsAllocator * pNorls) :
+    m_pNorls(pNorls),
+    m_cache(pNorls)
+{
+    ThrowIfNull(pNorls);
+}
+
+OverloadArityCache::Arity *
+OverloadArityCache::GetArities
+(
+    BCSYM_NamedRoot * pFirstOverload,
+    unsigned * pcOverloads                          //[out] - the number of entries returned
+)
+{
+    ThrowIfNull(pFirstOverload);
+    ThrowIfNull(pcOverloads);
+
+    Node * pNode = NULL;
+
+    if (m_cache.Find(&Key(pFirstOverload), &pNode))
+    {
+        TIMERCOUNT(COUNT_OverloadArityCacheHits, 1);
+        *pcOverloads = pNode->cOverloads;
+        return pNode->pArities;
+    }
+
+    TIMERCOUNT(COUNT_OverloadArityCacheMisses, 1);
+
+    unsigned cOverloads = 0;
+
+    for (BCSYM_NamedRoot * pOverload = pFirstOverload; pOverload; pOverload = pOverload->GetNextOverload())
+    {
+        cOverloads++;
+    }
+
+    Arity * pArities = (Arity *)m_pNorls->Alloc(VBMath::Multiply(cOverloads, sizeof(Arity)));
+    Arity * pArity = pArities;
+
+    for (BCSYM_NamedRoot * pOverload = pFirstOverload; pOverload; pOverload = pOverload->GetNextOverload(), pArity++)
+    {
+        BCSYM * pNonAlias = pOverload->DigThroughAlias();
+
+        // Alloc zeroes the memory, so only procedures need filling in.
+        if (pNonAlias->IsProc())
+        {
+            pArity->IsProcedure = true;
+            pArity->GenericParamCount = pOverload->GetGenericParamCount();
+            pNonAlias->PProc()->GetAllParameterCounts(
+                pArity->RequiredParameterCount,
+                pArity->MaximumParameterCount,
+                pArity->HasParamArray);
+        }
+    }
+
+    m_cache.Insert(&Key(pFirstOverload), &pNode);
+    pNode->pArities = pArities;
+    pNode->cOverloads = cOverloads;
+
+    *pcOverloads = cOverloads;
+    return pArities;
+}
+
+void OverloadArityCache::Clear()
+{
+    m_cache.Clear();
+}
+
+OverloadArityCache::Key::Key()
+{
+    memset(this, 0, sizeof(Key));
+}
+
+OverloadArityCache::Key::Key
+(
+    BCSYM_NamedRoot * pFirstOverload
+)
+{
+    memset(this, 0, sizeof(Key));
+    this->pFirstOverload = pFirstOverload;
+}
+
+int OverloadArityCache::KeyOperations::compare(
+    const Key * pKey1,
+    const Key * pKey2)
+{
+    return memcmp(pKey1, pKey2, sizeof(Key));
+}
+
+void OverloadArityCache::NodeOperations::copy(
+    Node * pNodeDest,
+    const Node * pNodeSrc)
+{
+    pNodeDest->pArities = pNodeSrc->pArities;
+    pNodeDest->cOverloads = pNodeSrc->cOverloads;
+}
+
 //forward declaration
 bool IsEqual(
     DynamicArray<VbCompilerWarningItemLevel> * memberWarningsLevelTable,
@@ -173,6 +357,13 @@ ExtensionMethodLookupCacheKeyObject::ExtensionMethodLookupCacheKeyObject(SourceF
     m_pSimpleObject = pSourceFile;
 }
 
+ExtensionMethodLookupCacheKeyObject::ExtensionMethodLookupCacheKeyObject(ExtensionMethodImportSet * pImportSet)
+{
+    memset(this, 0, sizeof(ExtensionMethodLookupCacheKeyObject));
+    m_type = KeyObject_ImportSet;
+    m_pSimpleObject = pImportSet;
+}
+
 int ExtensionMethodLookupCacheKeyObject::Compare(
     const ExtensionMethodLookupCacheKeyObject * pLeft,
     const ExtensionMethodLookupCacheKeyObject * pRight)
@@ -294,9 +485,57 @@ void ExtensionMethodNameLookupCache::AddEntry(
     }
 }
 
+ExtensionMethodImportSet * ExtensionMethodNameLookupCache::InternImportSet(
+    _In_count_(cTargets) void * const * rgTargets,
+    unsigned cTargets)
+{
+    size_t cbTargets = VBMath::Multiply(cTargets, sizeof(void *));
+    DWORD hash = CRC32(rgTargets, cbTargets);
+
+    ExtensionMethodImportSet * pFirst = NULL;
+    m_importSets.GetValue(hash, &pFirst);
+
+    for (ExtensionMethodImportSet * pImportSet = pFirst; pImportSet; pImportSet = pImportSet->m_pNext)
+    {
+        if (pImportSet->m_cTargets == cTargets &&
+            memcmp(pImportSet->m_rgTargets, rgTargets, cbTargets) == 0)
+        {
+            return pImportSet;
+        }
+    }
+
+    NorlsAllocator * pnorls = GetNorlsAllocator();
+    ExtensionMethodImportSet * pImportSet = (ExtensionMethodImportSet *)pnorls->Alloc(sizeof(ExtensionMethodImportSet));
+
+    pImportSet->m_rgTargets = (void **)pnorls->Alloc(cbTargets);
+    memcpy(pImportSet->m_rgTargets, rgTargets, cbTargets);
+    pImportSet->m_cTargets = cTargets;
+    pImportSet->m_pNext = pFirst;
+
+    m_importSets.SetValue(hash, pImportSet);
+
+    return pImportSet;
+}
+
+bool ExtensionMethodNameLookupCache::LookupSourceFileImportSet(
+    SourceFile * pSourceFile,
+    ExtensionMethodImportSet ** ppImportSet)
+{
+    return m_sourceFileImportSets.GetValue(pSourceFile, ppImportSet);
+}
+
+void ExtensionMethodNameLookupCache::SetSourceFileImportSet(
+    SourceFile * pSourceFile,
+    ExtensionMethodImportSet * pImportSet)
+{
+    m_sourceFileImportSets.SetValue(pSourceFile, pImportSet);
+}
+
 void ExtensionMethodNameLookupCache::Clear()
 {
     m_cache.Clear();
+    m_importSets.Clear();
+    m_sourceFileImportSets.Clear();
 }
 
 NorlsAllocator * ExtensionMethodNameLookupCache::GetNorlsAllocator()
@@ -309,6 +548,8 @@ CompilationCaches::CompilationCaches():
     m_LookupCache(&m_nrlsCachedData),
     m_ExtensionMethodLookupCache(&m_nrlsCachedData),  
     m_LiftedOperatorCache(&m_nrlsCachedData),
+    m_ConversionCache(&m_nrlsCachedData),
+    m_OverloadArityCache(&m_nrlsCachedData),
     m_MergedNamespaceCache(&m_nrlsCachedData)
 {
 #if IDE  
@@ -322,6 +563,8 @@ CompilationCaches::CompilationCaches(NorlsAllocator * pnorls):
     m_LookupCache(pnorls),
     m_ExtensionMethodLookupCache(pnorls),  
     m_LiftedOperatorCache(pnorls),
+    m_ConversionCache(pnorls),
+    m_OverloadArityCache(pnorls),
     m_MergedNamespaceCache(pnorls)
 {
     VSASSERT(GetCompilerSharedState()->IsInMainThread(), "GetCompilerSharedState()->IsInMainThread()");
@@ -359,6 +602,7 @@ void CompilationCaches::ClearCompilationCaches(int  cacheType /*= 0*/)
     if (cacheType  & CompCacheType_LookUp)
     {
         m_LookupCache.Clear();
+        m_OverloadArityCache.Clear();
     }
     if (cacheType  & CompCacheType_Extension)
     {
@@ -366,7 +610,9 @@ void CompilationCaches::ClearCompilationCaches(int  cacheType /*= 0*/)
     }
     if (cacheType  & CompCacheType_LiftedUDFOp )
     {
+        // The conversion cache holds user-defined operators too.
         m_LiftedOperatorCache.Clear();
+        m_ConversionCache.Clear();
     }
     if (cacheType  & CompCacheType_NSRing )
     {
@@ -594,6 +840,10 @@ CComBSTR ExtensionMethodNameLookupCache::tree_type::GetNodeDump(_In_opt_ bool fO
             case KeyObject_Symbol:
                 sb.AppendString(static_cast<BCSYM_NamedRoot *>( pNode->key.m_keyObject.m_pSimpleObject)->GetSimpleName());
                 break;
+
+            case KeyObject_ImportSet:
+                sb.AppendString(L"<imports>");
+                break;
                 
             default:
                 VSASSERT(false,"bad keyobject type for ExtensionMethodNameLookupCache");
@@ -697,6 +947,12 @@ void CompilationCaches::DumpStats()
     m_LiftedOperatorCache.m_cache.DumpTreeStats();
     m_LiftedOperatorCache.m_cache.GetNodeDump(true);
 
+    DebPrintf("Conv    ");
+    m_ConversionCache.m_cache.DumpTreeStats();
+
+    DebPrintf("Arity   ");
+    m_OverloadArityCache.m_cache.DumpTreeStats();
+
     DebPrintf("MrgdNsp ");
     m_MergedNamespaceCache.DumpTreeStats();
     m_MergedNamespaceCache.GetNodeDump(true);
@@ -704,6 +960,8 @@ void CompilationCaches::DumpStats()
     m_LookupCache.ClearTreeStats();
     m_ExtensionMethodLookupCache.m_cache.ClearTreeStats();
     m_LiftedOperatorCache.m_cache.ClearTreeStats();
+    m_ConversionCache.m_cache.ClearTreeStats();
+    m_OverloadArityCache.m_cache.ClearTreeStats();
     m_MergedNamespaceCache.ClearTreeStats();
     
 }
@@ -855,6 +1113,8 @@ CompilerProject::CompilerProject(Compiler * pCompiler)
 ,m_ImportsCache(&m_nrlsLookupCaches)
 ,m_ExtensionMethodLookupCache(&m_nrlsLookupCaches)
 ,m_LiftedOperatorCache(&m_nrlsLookupCaches)
+,m_ConversionCache(&m_nrlsLookupCaches)
+,m_OverloadArityCache(&m_nrlsLookupCaches)
 ,m_SourceFileCache(pCompiler)
 ,m_LangVersion(LANGUAGE_CURRENT)
 ,m_PotentiallyEmbedsPiaTypes(false)
@@ -864,6 +1124,8 @@ CompilerProject::CompilerProject(Compiler * pCompiler)
 ,m_isExpressionEditorProject(false)
 #endif IDE
 ,m_bIsHighEntropyVA(false)
+,m_fDeterministicOutput(false)
+,m_pstrContentHashFile(NULL)
 {
     DebCheckNoBackgroundThreads(m_pCompiler);
     m_projectId = ++m_lastProjectId;
@@ -1159,7 +1421,13 @@ void CompilerProject::Invalidate()
     // Clear the friends list.
     ClearFriends();
 
-
+#if !IDE
+    if (m_pPreparseCondCompErrors)
+    {
+        delete m_pPreparseCondCompErrors;
+        m_pPreparseCondCompErrors = NULL;
+    }
+#endif !IDE
 }
 
 void CompilerProject::ReleaseMyCollectionInfo()
@@ -7945,6 +8213,108 @@ void CompilerProject::RemoveCompilerFile(CompilerFile* pCompilerFile)
 // a file.
 //****************************************************************************
 
+#if !IDE
+
+void CompilerProject::PreparseDeclTreesWorkItem(void *pvFiles, unsigned iThread, long iFile)
+{
+    ((SourceFile **)pvFiles)[iFile]->PreparseDeclTrees();
+}
+
+//============================================================================
+// Parse the declaration trees of all the source files going to declared
+// state on several threads at once.  Only the parse is done here; the
+// symbols are still built by _StepToBuiltSymbols one file at a time and in
+// list order, so the result does not depend on which thread parsed what.
+//============================================================================
+
+void CompilerProject::ParseDeclTreesInParallel()
+{
+    unsigned cThreads = ParallelWork::GetThreadCount();
+    if (cThreads <= 1)
+    {
+        return;
+    }
+
+    // _PromoteToDeclared has just created the project level symbols.
+    CompilerProject *pProject = this;
+    PreparseDeclTrees(&pProject, 1, cThreads);
+}
+
+void CompilerProject::ParseDeclTreesInParallel
+(
+    CompilerProject **rgpProjects,
+    unsigned cProjects
+)
+{
+    unsigned cThreads = ParallelWork::GetThreadCount();
+    if (cThreads <= 1)
+    {
+        return;
+    }
+
+    for (unsigned iProject = 0; iProject < cProjects; iProject++)
+    {
+        CompilerProject *pProject = rgpProjects[iProject];
+
+        if (pProject->IsMetaData() || pProject->GetCompState() != CS_NoState)
+        {
+            continue;
+        }
+
+        // #If in the files depends on the project level symbols, so create
+        // them now, once.  _PromoteToDeclared keeps them and reports the errors.
+        if (!pProject->m_pPreparseCondCompErrors)
+        {
+            pProject->m_pPreparseCondCompErrors = new ErrorTable(pProject->m_pCompiler, pProject, NULL);
+            IfFailThrow(pProject->CreateProjectLevelCondCompSymbols(pProject->m_pPreparseCondCompErrors));
+        }
+    }
+
+    PreparseDeclTrees(rgpProjects, cProjects, cThreads);
+}
+
+void CompilerProject::PreparseDeclTrees
+(
+    CompilerProject **rgpProjects,
+    unsigned cProjects,
+    unsigned cThreads
+)
+{
+    DynamicArray<SourceFile *> daFiles;
+
+    for (unsigned iProject = 0; iProject < cProjects; iProject++)
+    {
+        CompilerProject *pProject = rgpProjects[iProject];
+
+        if (pProject->IsMetaData() || pProject->GetCompState() != CS_NoState)
+        {
+            continue;
+        }
+
+        CompilerFile *pfile;
+        CDoubleListForwardIter<CompilerFile> iter(&pProject->m_dlFiles[CS_NoState]);
+
+        while (pfile = iter.Next())
+        {
+            if (pfile->IsSourceFile() && !pfile->PSourceFile()->m_fPreparsedDeclTrees)
+            {
+                daFiles.AddElement(pfile->PSourceFile());
+            }
+        }
+    }
+
+    if (daFiles.Count() < 2)
+    {
+        return;
+    }
+
+    TIMEBLOCK(TIME_ParserDecls);
+
+    ParallelWork::Run(PreparseDeclTreesWorkItem, daFiles.Array(), daFiles.Count(), cThreads, TIME_ParserDecls);
+}
+
+#endif !IDE
+
 //============================================================================
 // Do the work to bring the project to declared state.
 //============================================================================
@@ -7965,8 +8335,21 @@ bool CompilerProject::_PromoteToDeclared()
 
     if (!IsMetaData())
     {
-        // Create the project level cond comp symbols, overwriting any that were created by the parser on the UI thread
-        IfFailThrow(CreateProjectLevelCondCompSymbols(&errors));
+#if !IDE
+        if (m_pPreparseCondCompErrors)
+        {
+            // ParseDeclTreesInParallel has already created them and parsed
+            // files against them, so keep them.
+            errors.MergeTemporaryTable(m_pPreparseCondCompErrors);
+            delete m_pPreparseCondCompErrors;
+            m_pPreparseCondCompErrors = NULL;
+        }
+        else
+#endif !IDE
+        {
+            // Create the project level cond comp symbols, overwriting any that were created by the parser on the UI thread
+            IfFailThrow(CreateProjectLevelCondCompSymbols(&errors));
+        }
     }
 
     STRING *DefaultNamespace = GetDefaultNamespace();
@@ -7995,6 +8378,10 @@ bool CompilerProject::_PromoteToDeclared()
     // Bring each file to declared.
     //========================================================================
 
+#if !IDE
+    ParseDeclTreesInParallel();
+#endif
+
     // Move all of the files in the project to the next state.
     while (pfile = m_dlFiles[CS_NoState].GetFirst())
     {
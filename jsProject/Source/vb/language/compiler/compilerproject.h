@@ -107,6 +107,18 @@ enum ExtensionMethodLookupCacheKeyObjectType
     KeyObject_SourceFileSymbol,
     KeyObject_Symbol,
     KeyObject_SourceFile,
+    KeyObject_ImportSet,
+};
+
+//An interned list of the classes and namespace rings that a source file's imports (and its project's imports)
+//bring extension methods in from. Source files whose imports resolve to the same list share one import set,
+//so the cache entries for the imports of one of them can be reused by all of them.
+struct ExtensionMethodImportSet
+{
+    void ** m_rgTargets;
+    unsigned m_cTargets;
+    //The next import set whose target list has the same hash.
+    ExtensionMethodImportSet * m_pNext;
 };
 
 
@@ -118,6 +130,7 @@ enum ExtensionMethodLookupCacheKeyObjectType
 //     2) A source file
 //     3) A compiler project
 //     4) A pair including poth a source file and a symbol
+//     5) An import set shared by all source files with the same imports
 //It is represented by a union and a type flag. For all type flags other than
 //KeyObject_SourceFileSymbol a simple void * is used. For KeyObject_SourceFileSymbol
 //a structre containing both a SourceFile * and a Symbol * is used.
@@ -159,6 +172,11 @@ struct ExtensionMethodLookupCacheKeyObject
         SourceFile * pSourceFile
     );
 
+    ExtensionMethodLookupCacheKeyObject
+    (
+        ExtensionMethodImportSet * pImportSet
+    );
+
 
     static int Compare
     (
@@ -220,6 +238,31 @@ public:
         ExtensionMethodLookupCacheEntry * pCacheValue
     );
 
+    //Returns the import set for the given list of import targets, creating it if no
+    //import set with the same targets (in the same order) has been interned yet.
+    ExtensionMethodImportSet *
+    InternImportSet
+    (
+        _In_count_(cTargets) void * const * rgTargets,
+        unsigned cTargets
+    );
+
+    //The import set last computed for a source file, so that it is computed once
+    //per file until the cache is cleared.
+    bool
+    LookupSourceFileImportSet
+    (
+        SourceFile * pSourceFile,
+        ExtensionMethodImportSet ** ppImportSet
+    );
+
+    void
+    SetSourceFileImportSet
+    (
+        SourceFile * pSourceFile,
+        ExtensionMethodImportSet * pImportSet
+    );
+
     void Clear();
     NorlsAllocator * GetNorlsAllocator();
 
@@ -262,6 +305,11 @@ public:
     typedef RedBlackTreeT<Key, KeyOperations, Node, NodeOperations> tree_type;
 private:
     tree_type m_cache;
+    //Import sets, keyed by a hash of their target lists. The sets themselves
+    //live on the cache's allocator and are dropped along with its entries.
+    DynamicHashTable<DWORD, ExtensionMethodImportSet *> m_importSets;
+    //The import set of each source file that has looked one up.
+    DynamicHashTable<SourceFile *, ExtensionMethodImportSet *> m_sourceFileImportSets;
 };
 
 
@@ -380,6 +428,168 @@ private:
     tree_type m_cache;
 };
 
+// Memoizes Semantics::ClassifyConversion for pairs of types that are declared
+// classes, structures or interfaces.  Such types are symbols that live until
+// the project is decompiled, and the caches get cleared then.  Generic bindings,
+// arrays and transient types are not cached: they are created anew by each
+// Semantics, so neither their addresses nor the classification's generic
+// context outlive it.
+class ConversionClassificationCache
+{
+    friend class CompilationCaches;
+    friend class CVbCompilerCompCache;
+public:
+
+    // Semantics.h comes after this file, so the enums are kept as ints.
+    struct Classification
+    {
+        int Result;                                     // a ConversionClass
+        BCSYM_Proc * pOperatorMethod;
+        int RelaxationLevel;                            // a DelegateRelaxationLevel
+        bool RequiresUnliftedAccessToNullableValue;
+        bool IsNarrowingDueToAmbiguity;
+    };
+
+    ConversionClassificationCache
+    (
+        NorlsAllocator * pNorls
+    );
+
+    bool
+    LookupInCache
+    (
+        BCSYM * pTargetType,
+        BCSYM * pSourceType,
+        bool considerConversionsOnNullableBool,
+        bool IgnoreOperatorMethod,
+        Classification * pCacheValue                    //[out] - the cached classification
+    );
+
+    void
+    AddEntry
+    (
+        BCSYM * pTargetType,
+        BCSYM * pSourceType,
+        bool considerConversionsOnNullableBool,
+        bool IgnoreOperatorMethod,
+        const Classification & CacheValue
+    );
+
+    void Clear();
+private:
+    // Keys are compared bytewise, so they are zeroed before being filled in.
+    struct Key
+    {
+        BCSYM * pTargetType;
+        BCSYM * pSourceType;
+        unsigned Flags;
+
+        Key();
+        Key
+        (
+            BCSYM * pTargetType,
+            BCSYM * pSourceType,
+            bool considerConversionsOnNullableBool,
+            bool IgnoreOperatorMethod
+        );
+    };
+public:
+    struct Node :
+        public RedBlackNodeBaseT<Key>
+    {
+        Classification Value;
+    };
+private:
+    struct KeyOperations :
+        public SimpleKeyOperationsT<Key>
+    {
+        int compare(const Key *pKey1, const Key * pKey2);
+    };
+
+    struct NodeOperations :
+        public EmptyNodeOperationsT<Node>
+    {
+        void copy(Node *pNodeDest, const Node *pNodeSrc);
+    };
+public:
+    typedef RedBlackTreeT<Key, KeyOperations, Node, NodeOperations> tree_type;
+private:
+    tree_type m_cache;
+};
+
+// The parameter counts of the members of an overload chain, so that overload
+// resolution can throw out the overloads that can't take the arguments of a
+// call without walking their parameters.  A chain is keyed by its first member,
+// and its counts are kept in chain order.  The same lifetime rules as for
+// ConversionClassificationCache apply: only chains of declared, non-transient
+// containers are cached.
+class OverloadArityCache
+{
+    friend class CompilationCaches;
+    friend class CVbCompilerCompCache;
+public:
+
+    struct Arity
+    {
+        unsigned RequiredParameterCount;    // non-optional, non-paramarray parameters
+        unsigned MaximumParameterCount;     // all parameters, paramarray unexpanded
+        unsigned GenericParamCount;
+        bool HasParamArray;
+        bool IsProcedure;                   // other members are all zero
+    };
+
+    OverloadArityCache
+    (
+        NorlsAllocator * pNorls
+    );
+
+    // Returns the counts of the chain starting with pFirstOverload, building
+    // them the first time the chain is asked for.
+    Arity *
+    GetArities
+    (
+        BCSYM_NamedRoot * pFirstOverload,
+        unsigned * pcOverloads                          //[out] - the number of entries returned
+    );
+
+    void Clear();
+private:
+    struct Key
+    {
+        BCSYM_NamedRoot * pFirstOverload;
+
+        Key();
+        Key
+        (
+            BCSYM_NamedRoot * pFirstOverload
+        );
+    };
+public:
+    struct Node :
+        public RedBlackNodeBaseT<Key>
+    {
+        Arity * pArities;
+        unsigned cOverloads;
+    };
+private:
+    struct KeyOperations :
+        public SimpleKeyOperationsT<Key>
+    {
+        int compare(const Key *pKey1, const Key * pKey2);
+    };
+
+    struct NodeOperations :
+        public EmptyNodeOperationsT<Node>
+    {
+        void copy(Node *pNodeDest, const Node *pNodeSrc);
+    };
+public:
+    typedef RedBlackTreeT<Key, KeyOperations, Node, NodeOperations> tree_type;
+private:
+    NorlsAllocator * m_pNorls;
+    tree_type m_cache;
+};
+
 
 struct LookupKey
 {
@@ -567,6 +777,16 @@ public:
         return &m_LiftedOperatorCache;
     }
 
+    ConversionClassificationCache *GetConversionCache()
+    {
+        return &m_ConversionCache;
+    }
+
+    OverloadArityCache *GetOverloadArityCache()
+    {
+        return &m_OverloadArityCache;
+    }
+
     NamespaceRingTree *GetMergedNamespaceCache()
     {
         return &m_MergedNamespaceCache;
@@ -585,6 +805,8 @@ private:
     LookupTree m_LookupCache;
     ExtensionMethodNameLookupCache m_ExtensionMethodLookupCache;
     LiftedUserDefinedOperatorCache m_LiftedOperatorCache;
+    ConversionClassificationCache m_ConversionCache;
+    OverloadArityCache m_OverloadArityCache;
     NamespaceRingTree m_MergedNamespaceCache;
     NorlsAllocator m_nrlsCachedData;
 };
@@ -1355,6 +1577,12 @@ private:
     // Do the work necessary to compile this project to declared.
     bool CompileToDeclared();
 
+#if !IDE
+    // Parse the declaration trees of the files of several projects at once,
+    // ahead of CompileToDeclared.  Does nothing unless parallel parsing is on.
+    static void ParseDeclTreesInParallel(CompilerProject **rgpProjects, unsigned cProjects);
+#endif
+
     // Do the work necessary to compile this project to Bound.
     bool CompileFromDeclaredToBound();
 
@@ -2077,6 +2305,17 @@ private:
     friend class EditFilter;
 
     // Promote the project.
+#if !IDE
+    void ParseDeclTreesInParallel();
+    static void PreparseDeclTrees(CompilerProject **rgpProjects, unsigned cProjects, unsigned cThreads);
+    static void PreparseDeclTreesWorkItem(void *pvFiles, unsigned iThread, long iFile);
+
+    // The errors from creating the project level conditional compilation
+    // symbols ahead of _PromoteToDeclared for the static ParseDeclTreesInParallel,
+    // which the files are then parsed against.  _PromoteToDeclared keeps those
+    // symbols instead of creating them again and reports these errors.
+    ErrorTable *m_pPreparseCondCompErrors;
+#endif
     bool _PromoteToDeclared();
     bool _PromoteToBound();
     bool _PromoteToTypesEmitted();
@@ -2733,10 +2972,28 @@ private:
 
     SubsystemVersion m_subsystemVersion;
 
+    // /deterministic: stamp the PE from a hash of its contents.
+    bool m_fDeterministicOutput;
+
+    // /contenthash:<file>: where to write that hash; NULL if nowhere.
+    STRING *m_pstrContentHashFile;
+
 public:
 
     bool IsHighEntropyVA(){ return m_bIsHighEntropyVA;}
 
+    // Set by the command line compiler from /deterministic and /contenthash; its
+    // option parser is not part of this tree.
+    void SetDeterministicOutput(bool fDeterministic, _In_opt_z_ STRING *pstrContentHashFile)
+    {
+        m_fDeterministicOutput = fDeterministic;
+        m_pstrContentHashFile = pstrContentHashFile;
+    }
+
+    bool IsDeterministicOutput() { return m_fDeterministicOutput; }
+
+    STRING *GetContentHashFile() { return m_pstrContentHashFile; }
+
     SubsystemVersion GetSubsystemVersion() { return m_subsystemVersion; }
 		
     bool IsDefaultVBRuntime();
@@ -3367,12 +3624,24 @@ public:
         return &m_LiftedOperatorCache;
     }
 
+    ConversionClassificationCache * GetConversionCache()
+    {
+        return &m_ConversionCache;
+    }
+
+    OverloadArityCache * GetOverloadArityCache()
+    {
+        return &m_OverloadArityCache;
+    }
+
     void ClearLookupCaches()
     {
         m_LookupCache.Clear();
         m_ImportsCache.Clear();
         m_ExtensionMethodLookupCache.Clear();
         m_LiftedOperatorCache.Clear();
+        m_ConversionCache.Clear();
+        m_OverloadArityCache.Clear();
         m_nrlsLookupCaches.FreeHeap();   
     }
 
@@ -3424,6 +3693,8 @@ private:
     // Note, this cache does not return the extension method symbol, it only answers whether the project contains an extension method with this name.
     HashSet<STRING_INFO*> m_ExtensionMethodExistsCache; // Entry for existence of an extension method with the name    
     LiftedUserDefinedOperatorCache m_LiftedOperatorCache;
+    ConversionClassificationCache m_ConversionCache;
+    OverloadArityCache m_OverloadArityCache;
 
     // The declaration type refs are populated when going to Declared state.
     HashSet<BCSYM*> m_DeclarationPiaTypeRefCache;
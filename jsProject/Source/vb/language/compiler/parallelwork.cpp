@@ -0,0 +1,105 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+//  Runs independent work items of a compilation stage on several threads
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "StdAfx.h"
+
+#if !IDE
+
+unsigned ParallelWork::GetThreadCount()
+{
+    const LPCWSTR wszEnvironmentVar = L"VBC_PARSE_THREADS";
+    WCHAR wszValue[16];
+
+    DWORD cch = GetEnvironmentVariableW(wszEnvironmentVar, wszValue, _countof(wszValue));
+    if (cch == 0 || cch >= _countof(wszValue))
+    {
+        return 1;
+    }
+
+    long cThreads = _wtol(wszValue);
+    if (cThreads <= 1)
+    {
+        return 1;
+    }
+
+    return (unsigned)min(cThreads, MAXIMUM_WAIT_OBJECTS);
+}
+
+unsigned ParallelWork::Run
+(
+    WorkItemProc pfnWorkItem,
+    void * pvContext,
+    long cItems,
+    unsigned cThreads,
+    TIMERID timerId
+)
+{
+    VSASSERT(cThreads >= 1 && cThreads <= MAXIMUM_WAIT_OBJECTS, "Bad thread count.");
+
+    Queue queue;
+    queue.m_pfnWorkItem = pfnWorkItem;
+    queue.m_pvContext = pvContext;
+    queue.m_cItems = cItems;
+    queue.m_iNextItem = 0;
+    queue.m_iNextThread = 1;
+
+    // The calling thread is one of the threads.
+    unsigned cHelpers = (unsigned)min((long)cThreads, cItems) - 1;
+    HANDLE rghThreads[MAXIMUM_WAIT_OBJECTS];
+    unsigned cStarted = 0;
+
+    for (unsigned i = 0; i < cHelpers; i++)
+    {
+        rghThreads[cStarted] = CreateThread(NULL, 0, ThreadProc, &queue, 0, NULL);
+
+        // If a thread can't be created, the ones that were share the work.
+        if (rghThreads[cStarted])
+        {
+            cStarted++;
+        }
+    }
+
+    DoWork(&queue, 0);
+
+    if (cStarted > 0)
+    {
+        WaitForMultipleObjects(cStarted, rghThreads, TRUE, INFINITE);
+    }
+
+    for (unsigned i = 0; i < cStarted; i++)
+    {
+        if (g_isTimingActive)
+        {
+            TimerAddCpuTime(timerId, GetThreadCpuTime(rghThreads[i]));
+        }
+
+        CloseHandle(rghThreads[i]);
+    }
+
+    return cStarted + 1;
+}
+
+void ParallelWork::DoWork(Queue * pQueue, unsigned iThread)
+{
+    long iItem;
+
+    while ((iItem = InterlockedIncrement(&pQueue->m_iNextItem) - 1) < pQueue->m_cItems)
+    {
+        pQueue->m_pfnWorkItem(pQueue->m_pvContext, iThread, iItem);
+    }
+}
+
+DWORD WINAPI ParallelWork::ThreadProc(void * pvQueue)
+{
+    Queue * pQueue = (Queue *)pvQueue;
+
+    DoWork(pQueue, (unsigned)(InterlockedIncrement(&pQueue->m_iNextThread) - 1));
+    return 0;
+}
+
+#endif !IDE
@@ -0,0 +1,62 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+//  Runs independent work items of a compilation stage on several threads
+//
+//-------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#if !IDE
+
+//-------------------------------------------------------------------------------------------------
+//
+// The command line compiler can run some stages (declaration and method body parsing) on more
+// than one thread.  This is off unless the VBC_PARSE_THREADS environment variable asks for more
+// than one thread.
+//
+// Items are handed out one at a time from a shared counter, so a thread that gets cheap items
+// simply takes more of them.  Each thread also gets a small index so that work items can use
+// per-thread state (allocators, Text) without locking.
+//
+// Work items must not throw, and must only touch state owned by the item, state owned by the
+// thread, or thread safe state such as the StringPool and the page heaps.  Merging results into
+// anything shared is up to the caller, after Run returns.
+//
+//-------------------------------------------------------------------------------------------------
+
+class ParallelWork
+{
+public:
+    // iThread is in [0, cThreads); the calling thread is 0.
+    typedef void (*WorkItemProc)(void * pvContext, unsigned iThread, long iItem);
+
+    // The number of threads parallel stages should use; 1 if they are off.
+    static unsigned GetThreadCount();
+
+    // Calls pfnWorkItem for each item in [0, cItems) on up to cThreads threads, including the
+    // calling thread, and returns once all items are done.  The CPU time of the helper threads is
+    // charged to timerId.  Returns the number of threads used.
+    static unsigned Run(
+        WorkItemProc pfnWorkItem,
+        void * pvContext,
+        long cItems,
+        unsigned cThreads,
+        TIMERID timerId);
+
+private:
+    struct Queue
+    {
+        WorkItemProc m_pfnWorkItem;
+        void * m_pvContext;
+        long m_cItems;
+        volatile long m_iNextItem;
+        volatile long m_iNextThread;
+    };
+
+    static void DoWork(Queue * pQueue, unsigned iThread);
+    static DWORD WINAPI ThreadProc(void * pvQueue);
+};
+
+#endif !IDE
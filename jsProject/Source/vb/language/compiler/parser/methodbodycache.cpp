@@ -0,0 +1,223 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+//  Cache of the parse trees of method bodies that get parsed more than once
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "StdAfx.h"
+
+volatile LONG MethodBodyParseCache::s_cbHeld = 0;
+
+MethodBodyParseCache::MethodBodyParseCache() :
+    m_nraEntries(NORLSLOC),
+    m_cEntries(0),
+    m_cbHeld(0)
+{
+}
+
+MethodBodyParseCache::~MethodBodyParseCache()
+{
+    Clear();
+}
+
+bool MethodBodyParseCache::HashText
+(
+    _In_count_(cchBody) const WCHAR * wszBody,
+    size_t cchBody,
+    _In_opt_count_(cchProc) const WCHAR * wszProc,
+    size_t cchProc,
+    _Inout_ MethodBodyParseKey * pKey,
+    _Out_ MethodBodyParseText * pText
+)
+{
+    if (!wszBody ||
+        wmemchr(wszBody, L'#', cchBody) ||
+        (wszProc && wmemchr(wszProc, L'#', cchProc)))
+    {
+        return false;
+    }
+
+    CRC32 crc(wszBody, cchBody * sizeof(WCHAR));
+
+    if (wszProc)
+    {
+        crc.Update(wszProc, cchProc * sizeof(WCHAR));
+    }
+    else
+    {
+        cchProc = 0;
+    }
+
+    pKey->m_crcText = crc;
+    pKey->m_cchBody = cchBody;
+    pKey->m_cchProc = cchProc;
+
+    pText->m_wszBody = wszBody;
+    pText->m_wszProc = wszProc;
+
+    return true;
+}
+
+ParseTree::MethodBodyStatement * MethodBodyParseCache::Lookup
+(
+    const MethodBodyParseKey & key,
+    const MethodBodyParseText & text,
+    _Out_ bool * pfAdmit
+)
+{
+    DWORD hash = GetHashCode(key);
+    SafeCriticalSectionLock lock(m_lock);
+
+    *pfAdmit = false;
+
+    Entry * pEntry = Find(key, hash);
+
+    if (pEntry && pEntry->m_pTree)
+    {
+        if (IsSameText(pEntry, text))
+        {
+            TIMERCOUNT(COUNT_MethodBodyCacheHits, 1);
+            return pEntry->m_pTree;
+        }
+
+        // Some other text with the same CRC.  The cached body keeps its entry.
+        TIMERCOUNT(COUNT_MethodBodyCacheMisses, 1);
+        return NULL;
+    }
+
+    TIMERCOUNT(COUNT_MethodBodyCacheMisses, 1);
+
+    if (!pEntry)
+    {
+        if (m_cEntries >= METHODBODYCACHE_MAX_ENTRIES)
+        {
+            // Trees already handed out may still be in use, so the cache can't start
+            // over until Clear.  Stop remembering new bodies instead.
+            return NULL;
+        }
+
+        // Remember the body so that it gets cached if it is asked for again.
+        m_cEntries++;
+        pEntry = new(m_nraEntries) Entry;
+        pEntry->m_key = key;
+
+        Entry * pFirst = NULL;
+        m_Entries.GetValue(hash, &pFirst);
+        pEntry->m_pNext = pFirst;
+        m_Entries.SetValue(hash, pEntry);
+    }
+    else if (!pEntry->m_fRejected)
+    {
+        *pfAdmit = s_cbHeld < METHODBODYCACHE_MAX_BYTES;
+    }
+
+    return NULL;
+}
+
+ParseTree::MethodBodyStatement * MethodBodyParseCache::Add
+(
+    const MethodBodyParseKey & key,
+    const MethodBodyParseText & text,
+    _In_opt_ NorlsAllocator * pnraTree,
+    _In_opt_ ParseTree::MethodBodyStatement * pTree
+)
+{
+    DWORD hash = GetHashCode(key);
+    SafeCriticalSectionLock lock(m_lock);
+
+    // The entry may be gone if the cache started over since the lookup.
+    Entry * pEntry = Find(key, hash);
+
+    if (!pEntry || pEntry->m_pTree || !pTree)
+    {
+        if (pEntry && !pTree)
+        {
+            pEntry->m_fRejected = true;
+        }
+
+        delete pnraTree;
+        return pEntry && pEntry->m_pTree && IsSameText(pEntry, text) ? pEntry->m_pTree : NULL;
+    }
+
+    WCHAR * wszBody = (WCHAR *)pnraTree->Alloc(VBMath::Multiply(key.m_cchBody, sizeof(WCHAR)));
+    memcpy(wszBody, text.m_wszBody, key.m_cchBody * sizeof(WCHAR));
+    pEntry->m_text.m_wszBody = wszBody;
+
+    if (text.m_wszProc)
+    {
+        WCHAR * wszProc = (WCHAR *)pnraTree->Alloc(VBMath::Multiply(key.m_cchProc, sizeof(WCHAR)));
+        memcpy(wszProc, text.m_wszProc, key.m_cchProc * sizeof(WCHAR));
+        pEntry->m_text.m_wszProc = wszProc;
+    }
+
+    pEntry->m_pnraTree = pnraTree;
+    pEntry->m_pTree = pTree;
+    pEntry->m_cbTree = pnraTree->CalcCommittedSize();
+
+    m_cbHeld += pEntry->m_cbTree;
+    InterlockedExchangeAdd(&s_cbHeld, (LONG)pEntry->m_cbTree);
+    TIMERCOUNT(COUNT_MethodBodyCacheBytesHeld, pEntry->m_cbTree);
+
+    return pTree;
+}
+
+void MethodBodyParseCache::Clear()
+{
+    SafeCriticalSectionLock lock(m_lock);
+
+    HashTableIterator<DWORD, Entry *, VBAllocWrapper> iter(&m_Entries);
+
+    while (iter.MoveNext())
+    {
+        for (Entry * pEntry = iter.Current().Value(); pEntry; pEntry = pEntry->m_pNext)
+        {
+            delete pEntry->m_pnraTree;
+        }
+    }
+
+    InterlockedExchangeAdd(&s_cbHeld, -(LONG)m_cbHeld);
+    TIMERCOUNT(COUNT_MethodBodyCacheBytesHeld, -(__int64)m_cbHeld);
+    m_cbHeld = 0;
+
+    m_Entries.Clear();
+    m_nraEntries.FreeHeap();
+    m_cEntries = 0;
+}
+
+DWORD MethodBodyParseCache::GetHashCode(const MethodBodyParseKey & key)
+{
+    return CRC32(&key);
+}
+
+bool MethodBodyParseCache::IsSameText
+(
+    const Entry * pEntry,
+    const MethodBodyParseText & text
+)
+{
+    const MethodBodyParseKey & key = pEntry->m_key;
+
+    return
+        memcmp(pEntry->m_text.m_wszBody, text.m_wszBody, key.m_cchBody * sizeof(WCHAR)) == 0 &&
+        (!key.m_cchProc ||
+            memcmp(pEntry->m_text.m_wszProc, text.m_wszProc, key.m_cchProc * sizeof(WCHAR)) == 0);
+}
+
+MethodBodyParseCache::Entry * MethodBodyParseCache::Find
+(
+    const MethodBodyParseKey & key,
+    DWORD hash
+)
+{
+    Entry * pEntry = NULL;
+    m_Entries.GetValue(hash, &pEntry);
+
+    while (pEntry && memcmp(&pEntry->m_key, &key, sizeof(key)) != 0)
+    {
+        pEntry = pEntry->m_pNext;
+    }
+
+    return pEntry;
+}
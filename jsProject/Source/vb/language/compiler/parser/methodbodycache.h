@@ -0,0 +1,129 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+//  Cache of the parse trees of method bodies that get parsed more than once
+//
+//-------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+//
+// Some method bodies are parsed over and over: the IDE binds a body for several features, ENC
+// and XML doc generation bind bodies the build already bound, and so on.  MethodBodyParseCache
+// keeps the trees of such bodies so that they are parsed only once.
+//
+// A body is keyed by a CRC of its text (and of its definition, if that was asked for), where the
+// text starts, and the options the parser depends on.  A cached body keeps a copy of its text,
+// which a hit must match exactly, so an entry can't be returned for text that has since changed
+// or that merely has the same CRC; it just stops being hit.
+//
+// A body is only cached the second time it is asked for, so a body that is parsed once costs no
+// more than its key.  Bodies are never cached if
+//   - their text contains a '#', since the tree of a body with conditional compilation depends on
+//     constants defined outside of it.  Date literals get caught by this too, which is harmless.
+//   - parsing them reported errors or warnings, since a hit would have to report them again.
+//
+// Cached trees are handed to everyone who asks for that body, so they must not be modified.
+// Bound trees point into them, so they live until Clear, which the owning SourceFile calls when
+// it throws away its symbols.  Once the cache has seen METHODBODYCACHE_MAX_ENTRIES bodies it
+// stops taking on new ones until then.
+//
+// The cache is thread safe, as the command line compiler parses a file's bodies on several
+// threads.  Hits, misses and the bytes held are reported through the timing counters.
+//
+//-------------------------------------------------------------------------------------------------
+
+// The most memory all the caches together hold on to.
+#define METHODBODYCACHE_MAX_BYTES   (32 * 1024 * 1024)
+
+// The most bodies one cache remembers, cached or not, until it is cleared.
+#define METHODBODYCACHE_MAX_ENTRIES 4096
+
+// Keys are hashed and compared bytewise, so zero them before filling them in.
+struct MethodBodyParseKey
+{
+    DWORD m_crcText;
+    size_t m_cchBody;
+    size_t m_cchProc;                   // 0 if the definition wasn't asked for.
+    long m_lBodyLine;
+    long m_lBodyColumn;
+    long m_lProcLine;
+    long m_lProcColumn;
+    ParseTree::Statement::Opcodes m_MethodBodyKind;
+    MethodDeclKind m_MethodDeclKind;
+    LANGVERSION m_LanguageVersion;
+    bool m_fXMLDocOn;
+};
+
+// The text a key was made from; the lengths are in the key.
+struct MethodBodyParseText
+{
+    const WCHAR * m_wszBody;
+    const WCHAR * m_wszProc;            // NULL if the definition wasn't asked for.
+};
+
+class MethodBodyParseCache
+{
+public:
+    MethodBodyParseCache();
+    ~MethodBodyParseCache();
+
+    // Fills in the text part of a key whose other fields are set.  Returns false if the body
+    // can't be cached.  wszProc may be NULL.  The text must stay put while the key is in use.
+    static bool HashText(
+        _In_count_(cchBody) const WCHAR * wszBody,
+        size_t cchBody,
+        _In_opt_count_(cchProc) const WCHAR * wszProc,
+        size_t cchProc,
+        _Inout_ MethodBodyParseKey * pKey,
+        _Out_ MethodBodyParseText * pText);
+
+    // Returns the cached tree of the body, or NULL.  On NULL, *pfAdmit says whether the caller
+    // should parse the body into an allocator of its own and hand the result to Add.
+    ParseTree::MethodBodyStatement * Lookup(
+        const MethodBodyParseKey & key,
+        const MethodBodyParseText & text,
+        _Out_ bool * pfAdmit);
+
+    // Caches the tree of an admitted body and takes ownership of the allocator holding it.
+    // Pass a NULL tree (and allocator) if the body turned out not to be cacheable.  Returns the
+    // tree to use, which is a different one if another thread added the body first, or NULL
+    // if the tree can't be cached and the caller has to parse the body itself.
+    ParseTree::MethodBodyStatement * Add(
+        const MethodBodyParseKey & key,
+        const MethodBodyParseText & text,
+        _In_opt_ NorlsAllocator * pnraTree,
+        _In_opt_ ParseTree::MethodBodyStatement * pTree);
+
+    // Frees all the cached trees.
+    void Clear();
+
+private:
+    struct Entry
+    {
+        MethodBodyParseKey m_key;
+        NorlsAllocator * m_pnraTree;
+        ParseTree::MethodBodyStatement * m_pTree;
+        MethodBodyParseText m_text;     // copies in m_pnraTree, once there is a tree.
+        size_t m_cbTree;
+        bool m_fRejected;               // didn't parse clean; don't try again.
+        Entry * m_pNext;                // next entry with the same hash.
+    };
+
+    static DWORD GetHashCode(const MethodBodyParseKey & key);
+
+    static bool IsSameText(const Entry * pEntry, const MethodBodyParseText & text);
+
+    // The caller holds m_lock.
+    Entry * Find(const MethodBodyParseKey & key, DWORD hash);
+
+    SafeCriticalSection m_lock;         // protects the members below.
+    NorlsAllocator m_nraEntries;
+    DynamicHashTable<DWORD, Entry *> m_Entries;
+    unsigned m_cEntries;
+    size_t m_cbHeld;
+
+    static volatile LONG s_cbHeld;      // by all caches.
+};
@@ -1352,6 +1352,7 @@ Parser::Parser
     m_Compiler = TheCompiler;
     m_CompilerHost = TheCompilerHost;
     m_pStringPool = m_Compiler ? m_Compiler->GetStringPool() : NULL;
+    m_InputFile = NULL;
 
     m_LastInContexts = m_ScratchLastInContexts;
     m_MaxContextDepth = sizeof(m_ScratchLastInContexts) / sizeof(ParseTree::StatementList *); 
@@ -1397,6 +1398,7 @@ Parser::ParseDecls
     TIMEBLOCK(TIME_ParserDecls);
 
     m_Conditionals.Init(&m_TreeStorage);
+    m_InputFile = InputFile;
 
 
     // Set up the context for conditional compilation symbols.
@@ -1505,6 +1507,7 @@ Parser::ParseMethodBody
     TIMEBLOCK(TIME_ParserMethodBody); 
 
     bool MethodIsEmpty = true;
+    bool LinkedConditionalConstantsScope = false;
 
     m_Conditionals.Init(&m_TreeStorage);
     m_ConditionalConstantsScope = NULL;
@@ -1513,12 +1516,21 @@ Parser::ParseMethodBody
     {
         m_ConditionalConstantsScope = ConditionalCompilationConstants->PCCContainer();
 
-        // Clear the parent before (possibly) setting it to a (possibly) different value.
-        Symbols::ClearParent(m_ConditionalConstantsScope);
-
-        if (ProjectLevelCondCompScope)
+        // The scope is shared by all the bodies of the file.  If the caller has already
+        // linked it to the project level scope, leave it alone: the command line compiler
+        // parses several bodies of a file at once (see PEBuilder::PreparseMethodBodies).
+        if (m_ConditionalConstantsScope->GetImmediateParent() !=
+                (ProjectLevelCondCompScope ? ProjectLevelCondCompScope->GetHash() : NULL))
         {
-            Symbols::SetParent(m_ConditionalConstantsScope, ProjectLevelCondCompScope->GetHash());
+            LinkedConditionalConstantsScope = true;
+
+            // Clear the parent before (possibly) setting it to a (possibly) different value.
+            Symbols::ClearParent(m_ConditionalConstantsScope);
+
+            if (ProjectLevelCondCompScope)
+            {
+                Symbols::SetParent(m_ConditionalConstantsScope, ProjectLevelCondCompScope->GetHash());
+            }
         }
     }
 
@@ -1640,7 +1652,7 @@ Parser::ParseMethodBody
 
     m_ParsingMethodBody = false;
 
-    if (m_ConditionalConstantsScope)
+    if (LinkedConditionalConstantsScope)
     {
         // Clear the CC scope's parent (see VS RAID 231584)
         Symbols::ClearParent(m_ConditionalConstantsScope);
@@ -23319,37 +23331,17 @@ Parser::ParseConditionalCompilationStatement
                             ResyncAt(0);
                         }
 #if !IDE
-                        else
+                        else if (m_InputFile)
                         {
-                            ERRID error;
-                            bool result =
-                                m_Compiler->GetProjectBeingCompiled()->AddExternalChecksum
-                                (
-                                    ExternalSourceFileName,
-                                    ExternalGuid,
-                                    ExternalChecksumVal,
-                                    error);
-                            if (!result)
-                            {
-                                Location *wrnSpan;
-                                switch (error)
-                                {
-                                case WRNID_BadChecksumValExtChecksum:
-                                    wrnSpan = &StringLiteralChecksumVal->TextSpan;
-                                    break;
-                                case WRNID_MultipleDeclFileExtChecksum:
-                                    wrnSpan = &StringLiteralFileName->TextSpan;
-                                    break;
-                                case WRNID_BadGUIDFormatExtChecksum:
-                                    wrnSpan = &StringLiteralGuid->TextSpan;
-                                    break;
-                                default:
-                                    VSFAIL("unexpected error in external checksum");
-                                    wrnSpan = &StringLiteralFileName->TextSpan;
-                                }
-
-                                ReportSyntaxError(error, wrnSpan, ErrorInConstruct);
-                            }
+                            // The directive is checked and added to the project later, on
+                            // the compile thread, since declarations may be parsed on any thread.
+                            m_InputFile->AddExternalChecksumDirective(
+                                ExternalSourceFileName,
+                                ExternalGuid,
+                                ExternalChecksumVal,
+                                StringLiteralFileName->TextSpan,
+                                StringLiteralGuid->TextSpan,
+                                StringLiteralChecksumVal->TextSpan);
                         }
 #endif
 
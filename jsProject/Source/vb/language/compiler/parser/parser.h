@@ -2606,6 +2606,9 @@ private:
     CompilerHost *m_CompilerHost;
     StringPool* m_pStringPool;
 
+    // The file whose declarations are being parsed, if any.
+    SourceFile *m_InputFile;
+
 
     // The input stream of tokens.
     Scanner *m_InputStream;
@@ -82,3 +82,146 @@ tokens TokenOfString(_In_z_ STRING *pstr)
 {
     return Compiler::TokenOfString(pstr);
 }
+
+//============================================================================
+// KeywordHashTable
+//============================================================================
+
+KeywordHashTable::KeywordHashTable() :
+    m_cchMaxKeyword(0)
+{
+    unsigned BucketSizes[BucketCount];
+    unsigned Hashes[tkKwdIdLast + 1];
+
+    memset(BucketSizes, 0, sizeof(BucketSizes));
+    memset(m_Displacements, 0, sizeof(m_Displacements));
+    memset(m_Slots, 0, sizeof(m_Slots));
+
+    COMPILE_ASSERT(tkNone == 0);
+    COMPILE_ASSERT(tkKwdIdLast - tkKwdIdFirst < SlotCount);
+
+    for (unsigned tk = tkKwdIdFirst + 1; tk <= tkKwdIdLast; tk++)
+    {
+        size_t cchKeyword = g_tkKwdNameLengths[tk];
+
+        Hashes[tk] = HashSpelling(g_tkKwdNames[tk], cchKeyword);
+        BucketSizes[BucketOf(Hashes[tk])]++;
+
+        if (cchKeyword > m_cchMaxKeyword)
+        {
+            m_cchMaxKeyword = cchKeyword;
+        }
+    }
+
+    // Place the buckets largest first; they are the hardest to fit.
+    for (unsigned BucketSize = tkKwdIdLast - tkKwdIdFirst; BucketSize > 0; BucketSize--)
+    {
+        for (unsigned iBucket = 0; iBucket < BucketCount; iBucket++)
+        {
+            if (BucketSizes[iBucket] != BucketSize)
+            {
+                continue;
+            }
+
+            unsigned Displacement;
+
+            for (Displacement = 1; Displacement <= 0xFFFF; Displacement++)
+            {
+                unsigned tk;
+
+                // Tentatively claim a slot for every member of the bucket.
+                for (tk = tkKwdIdFirst + 1; tk <= tkKwdIdLast; tk++)
+                {
+                    if (BucketOf(Hashes[tk]) == iBucket)
+                    {
+                        unsigned iSlot = SlotOf(Hashes[tk], Displacement);
+
+                        if (m_Slots[iSlot] != tkNone)
+                        {
+                            break;
+                        }
+
+                        m_Slots[iSlot] = (unsigned short)tk;
+                    }
+                }
+
+                if (tk > tkKwdIdLast)
+                {
+                    break;
+                }
+
+                // Collision: release the slots claimed by this attempt.
+                for (unsigned tkUndo = tkKwdIdFirst + 1; tkUndo < tk; tkUndo++)
+                {
+                    if (BucketOf(Hashes[tkUndo]) == iBucket)
+                    {
+                        m_Slots[SlotOf(Hashes[tkUndo], Displacement)] = tkNone;
+                    }
+                }
+            }
+
+            VSASSERT(Displacement <= 0xFFFF, "No perfect hash for the keyword table; grow SlotCount.");
+            m_Displacements[iBucket] = (unsigned short)Displacement;
+        }
+    }
+}
+
+tokens KeywordHashTable::Lookup(
+    _In_count_(cchSize) const WCHAR *pwchar,
+    size_t cchSize) const
+{
+    if (cchSize == 0 || cchSize > m_cchMaxKeyword)
+    {
+        return tkNone;
+    }
+
+    unsigned ulHash = HashSpelling(pwchar, cchSize);
+    tokens tk = (tokens)m_Slots[SlotOf(ulHash, m_Displacements[BucketOf(ulHash)])];
+
+    if (tk == tkNone || (size_t)g_tkKwdNameLengths[tk] != cchSize)
+    {
+        return tkNone;
+    }
+
+    // Keyword spellings are all ASCII letters, so folding 0x20 is an exact
+    // case-insensitive compare as long as the input is ASCII too.  Anything
+    // else (e.g. full width keywords) is left to the string pool.
+    const WCHAR *pwchKeyword = g_tkKwdNames[tk];
+
+    for (size_t ich = 0; ich < cchSize; ich++)
+    {
+        if (pwchar[ich] >= 128 || (pwchar[ich] | 0x20) != (pwchKeyword[ich] | 0x20))
+        {
+            return tkNone;
+        }
+    }
+
+    return tk;
+}
+
+unsigned KeywordHashTable::HashSpelling(
+    _In_count_(cchSize) const WCHAR *pwchar,
+    size_t cchSize)
+{
+    // FNV-1a over the case-folded characters.  Folding non-letters is harmless;
+    // Lookup verifies the spelling.
+    unsigned ulHash = 0x811C9DC5;
+
+    for (size_t ich = 0; ich < cchSize; ich++)
+    {
+        ulHash = (ulHash ^ (pwchar[ich] | 0x20)) * 0x01000193;
+    }
+
+    return ulHash;
+}
+
+unsigned KeywordHashTable::SlotOf(
+    unsigned ulHash,
+    unsigned Displacement)
+{
+    ulHash ^= Displacement * 0x9E3779B9;
+    ulHash = (ulHash ^ (ulHash >> 16)) * 0x85EBCA6B;
+    ulHash ^= ulHash >> 13;
+
+    return ulHash & (SlotCount - 1);
+}
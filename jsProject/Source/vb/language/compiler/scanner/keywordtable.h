@@ -107,3 +107,52 @@ bool KeywordIsNew7to8(tokens tok)
     VSASSERT(tok < tkKwdCount, "Should be Less");
     return g_tkKwdDescs[tok].kdNew7to8kwd;
 }
+
+//-------------------------------------------------------------------------------------------------
+//
+// Perfect hash over the spellings of the keywords in [tkKwdIdFirst, tkKwdIdLast].
+//
+// The table is built once from g_tkKwdNames using hash-and-displace: spellings are
+// grouped into buckets by a case-folded hash, and each bucket is given a displacement
+// that sends all of its members to distinct free slots.  Lookup is therefore one hash,
+// one slot probe and one case-insensitive compare, and never touches the string pool.
+//
+// The table is immutable after construction and can be read from any thread.
+//
+class KeywordHashTable
+{
+public:
+    KeywordHashTable();
+
+    // Returns the keyword token for the spelling, ignoring ASCII case, or tkNone.
+    tokens Lookup(
+        _In_count_(cchSize) const WCHAR *pwchar,
+        size_t cchSize) const;
+
+private:
+    enum
+    {
+        BucketCount = 128,      // must be a power of 2
+        SlotCount = 512,        // must be a power of 2
+    };
+
+    static
+    unsigned HashSpelling(
+        _In_count_(cchSize) const WCHAR *pwchar,
+        size_t cchSize);
+
+    static
+    unsigned SlotOf(
+        unsigned ulHash,
+        unsigned Displacement);
+
+    static
+    unsigned BucketOf(unsigned ulHash)
+    {
+        return (ulHash >> 8) & (BucketCount - 1);
+    }
+
+    size_t m_cchMaxKeyword;
+    unsigned short m_Displacements[BucketCount];
+    unsigned short m_Slots[SlotCount];       // the token in each slot, or tkNone
+};
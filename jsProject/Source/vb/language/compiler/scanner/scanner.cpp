@@ -221,6 +221,7 @@ Scanner::Init(
     Second->m_Next = First;
 
     m_FirstFreeToken = First;
+    m_TokenRingSize = 2;
 
     m_State.Init(VB);
 }
@@ -317,6 +318,192 @@ IsIdentifierCharacter
     return IsWideIdentifierCharacter(c);
 }
 
+//
+// SSE2 helpers for the hot scanning loops.
+//
+// Each helper compares eight UTF-16 code units per step and returns a pointer to the
+// first character it does not skip, or to the final partial block.  Whatever
+// is left (that character and the final partial block) goes back to the scalar loop in
+// the caller, so the result is the same as the table-driven code's.
+//
+// SkipAsciiIdentifierCharacters and SkipAsciiBlanks skip ASCII runs only and stop at the
+// first non-ASCII character, leaving it to the caller to classify.  SkipToLineBreak skips
+// every unit, non-ASCII ones included, that is not one of the line breaks it tests for.
+//
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define SCANNER_SSE2 1
+#endif
+
+#if SCANNER_SSE2
+
+#include <emmintrin.h>
+
+// Number of WCHARs processed per SSE2 step.
+const size_t SseBlockWidth = sizeof(__m128i) / sizeof(WCHAR);
+
+// Returns the index of the first lane in Mask (one bit pair per WCHAR, as produced
+// by _mm_movemask_epi8) that is set.  Mask must be nonzero.
+inline size_t
+FirstSetLane
+(
+    unsigned Mask
+)
+{
+    unsigned long BitIndex;
+    _BitScanForward(&BitIndex, Mask);
+    return BitIndex / sizeof(WCHAR);
+}
+
+// Lanes of Block that lie in [Low, High].  The compares are signed, so characters
+// at or above 0x8000 are never in range; all ranges used here are ASCII.
+inline __m128i
+InRange
+(
+    __m128i Block,
+    short Low,
+    short High
+)
+{
+    return _mm_and_si128(
+        _mm_cmpgt_epi16(Block, _mm_set1_epi16(Low - 1)),
+        _mm_cmpgt_epi16(_mm_set1_epi16(High + 1), Block));
+}
+
+// Skip a run of ASCII identifier characters ([0-9A-Za-z_]).
+inline const WCHAR *
+SkipAsciiIdentifierCharacters
+(
+    _In_ const WCHAR *Here,
+    _In_ const WCHAR *End
+)
+{
+    while ((size_t)(End - Here) >= SseBlockWidth)
+    {
+        __m128i Block = _mm_loadu_si128((const __m128i *)Here);
+
+        // Folding 0x20 into the block maps 'A'-'Z' onto 'a'-'z' without pulling any
+        // other character into that range.
+        __m128i IsIdChar =
+            _mm_or_si128(
+                _mm_or_si128(
+                    InRange(Block, '0', '9'),
+                    InRange(_mm_or_si128(Block, _mm_set1_epi16(0x20)), 'a', 'z')),
+                _mm_cmpeq_epi16(Block, _mm_set1_epi16('_')));
+
+        unsigned Mask = (unsigned)_mm_movemask_epi8(IsIdChar) ^ 0xFFFF;
+
+        if (Mask)
+        {
+            return Here + FirstSetLane(Mask);
+        }
+
+        Here += SseBlockWidth;
+    }
+
+    return Here;
+}
+
+// Skip a run of ASCII blanks (space and tab).
+inline const WCHAR *
+SkipAsciiBlanks
+(
+    _In_ const WCHAR *Here,
+    _In_ const WCHAR *End
+)
+{
+    while ((size_t)(End - Here) >= SseBlockWidth)
+    {
+        __m128i Block = _mm_loadu_si128((const __m128i *)Here);
+
+        __m128i IsBlankChar =
+            _mm_or_si128(
+                _mm_cmpeq_epi16(Block, _mm_set1_epi16(0x0020)),
+                _mm_cmpeq_epi16(Block, _mm_set1_epi16(0x0009)));
+
+        unsigned Mask = (unsigned)_mm_movemask_epi8(IsBlankChar) ^ 0xFFFF;
+
+        if (Mask)
+        {
+            return Here + FirstSetLane(Mask);
+        }
+
+        Here += SseBlockWidth;
+    }
+
+    return Here;
+}
+
+// Skip to the next line break (CR, LF, NEL, LS or PS), as in a comment body.
+inline const WCHAR *
+SkipToLineBreak
+(
+    _In_ const WCHAR *Here,
+    _In_ const WCHAR *End
+)
+{
+    while ((size_t)(End - Here) >= SseBlockWidth)
+    {
+        __m128i Block = _mm_loadu_si128((const __m128i *)Here);
+
+        __m128i IsBreakChar =
+            _mm_or_si128(
+                _mm_or_si128(
+                    _mm_cmpeq_epi16(Block, _mm_set1_epi16(UCH_CR)),
+                    _mm_cmpeq_epi16(Block, _mm_set1_epi16(UCH_LF))),
+                _mm_or_si128(
+                    _mm_cmpeq_epi16(Block, _mm_set1_epi16(UCH_NEL)),
+                    _mm_or_si128(
+                        _mm_cmpeq_epi16(Block, _mm_set1_epi16((short)UCH_LS)),
+                        _mm_cmpeq_epi16(Block, _mm_set1_epi16((short)UCH_PS)))));
+
+        unsigned Mask = (unsigned)_mm_movemask_epi8(IsBreakChar);
+
+        if (Mask)
+        {
+            return Here + FirstSetLane(Mask);
+        }
+
+        Here += SseBlockWidth;
+    }
+
+    return Here;
+}
+
+#else // !SCANNER_SSE2
+
+inline const WCHAR *
+SkipAsciiIdentifierCharacters
+(
+    _In_ const WCHAR *Here,
+    _In_ const WCHAR *End
+)
+{
+    return Here;
+}
+
+inline const WCHAR *
+SkipAsciiBlanks
+(
+    _In_ const WCHAR *Here,
+    _In_ const WCHAR *End
+)
+{
+    return Here;
+}
+
+inline const WCHAR *
+SkipToLineBreak
+(
+    _In_ const WCHAR *Here,
+    _In_ const WCHAR *End
+)
+{
+    return Here;
+}
+
+#endif // SCANNER_SSE2
+
 inline bool
 BeginsExponent
 (
@@ -575,14 +762,7 @@ Scanner::NextFreeToken
 )
 {
     if (m_FirstFreeToken->m_Next == m_FirstInUseToken) {
-
-        Token *New = new(m_Storage) Token;
-
-        m_FirstFreeToken->m_Next = New;
-        New->m_Prev = m_FirstFreeToken;
-
-        New->m_Next = m_FirstInUseToken;
-        m_FirstInUseToken->m_Prev = New;
+        GrowTokenRing();
     }
 
     /* We used to be clever and only clear the token in the case that weren't growing the token ring.
@@ -628,6 +808,36 @@ Scanner::NextFreeToken
     return Result;
 }
 
+// Tokens added to the ring at once, at most.  A logical line rarely needs more.
+const unsigned MaxTokenRingGrowth = 256;
+
+void
+Scanner::GrowTokenRing
+(
+)
+{
+    // Double the ring, up to MaxTokenRingGrowth tokens at a time.  The new tokens
+    // come from one allocation and are linked in address order.
+    unsigned Count = min(m_TokenRingSize, MaxTokenRingGrowth);
+    Token *New = m_Storage.AllocArray<Token>(Count);
+
+    for (unsigned i = 0; i + 1 < Count; i++)
+    {
+        New[i].m_Next = &New[i + 1];
+        New[i + 1].m_Prev = &New[i];
+    }
+
+    Token *Last = &New[Count - 1];
+
+    Last->m_Next = m_FirstFreeToken->m_Next;
+    m_FirstFreeToken->m_Next->m_Prev = Last;
+
+    m_FirstFreeToken->m_Next = New;
+    New->m_Prev = m_FirstFreeToken;
+
+    m_TokenRingSize += Count;
+}
+
 Token *
 Scanner::MakeToken
 (
@@ -969,7 +1179,7 @@ Scanner::EatWhitespace
     // running the loop.  Would have to check callers before making that change
     // though.
 
-    const WCHAR *Here = m_InputStreamPosition + 1;
+    const WCHAR *Here = SkipAsciiBlanks(m_InputStreamPosition + 1, m_InputStreamEnd);
 
     while (Here < m_InputStreamEnd && IsBlank(*Here)) {
 
@@ -1209,6 +1419,8 @@ void Scanner::ScanComment
 
     const WCHAR *CommentStart = Here;
 
+    Here = SkipToLineBreak(Here, m_InputStreamEnd);
+
     while (Here < m_InputStreamEnd) {
 
         WCHAR Next = *Here;
@@ -1278,8 +1490,10 @@ Scanner::ScanIdentifier
 
     // The C++ compiler refuses to inline IsIdentifierCharacter, so the
     // < 128 test is inline here. (This loop gets a *lot* of traffic.)
+    // ASCII runs are consumed eight characters at a time; the table is only
+    // consulted at the end of a run and for non-ASCII characters.
 
-    while (Here < m_InputStreamEnd &&
+    while ((Here = SkipAsciiIdentifierCharacters(Here, m_InputStreamEnd)) < m_InputStreamEnd &&
            (*Here < 128 ? IsIDChar[*Here] : IsWideIdentifierCharacter(*Here)))
     {
         Here++;
@@ -1298,12 +1512,18 @@ Scanner::ScanIdentifier
         IdStringLength = MaxIdentifierLength;
     }
 
-    STRING *IdString;
+    // Most keywords are spelled in their canonical casing; those are found
+    // without taking the string pool lock.
 
-    IdString =
-        m_pStringPool->AddStringWithLen(
-            IdStart,
-            IdStringLength);
+    STRING *IdString = m_pStringPool->LookupKeywordWithLen(IdStart, IdStringLength);
+
+    if (!IdString)
+    {
+        IdString =
+            m_pStringPool->AddStringWithLen(
+                IdStart,
+                IdStringLength);
+    }
 
     tokens IdAsKeyword = (tokens)StringPool::TokenOfString(IdString);
 
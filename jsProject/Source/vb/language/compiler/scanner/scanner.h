@@ -916,9 +916,11 @@ protected:
     NorlsAllocator m_Storage;
 
     // A Scanner keeps track of Tokens in a ring, and allocates Tokens as necessary
-    // to prevent reusing an in-use Token.
+    // to prevent reusing an in-use Token.  The ring grows by contiguous blocks of
+    // Tokens linked in address order, so walking it walks memory sequentially.
     Token *m_FirstFreeToken;
     Token *m_FirstInUseToken;
+    unsigned m_TokenRingSize;
 
     Token *m_FirstTokenOfLine;
 
@@ -1041,6 +1043,9 @@ protected:
     // NextFreeToken returns the next not-in-use token, allocating one if necessary.
     Token *NextFreeToken ();
 
+    // GrowTokenRing inserts a block of free tokens after m_FirstFreeToken.
+    void GrowTokenRing ();
+
     // MakeToken fills in the common fields of the next not-in-use token. It assumes that
     // the token begins at m_wchInputStreamPosition.
     Token *
@@ -231,6 +231,21 @@ Semantics::ClassifyConversionFromExpression
 };
 
 
+// Can ClassifyConversion of this type be kept in a ConversionClassificationCache?
+static bool
+IsConversionCacheable
+(
+    Type *pType
+)
+{
+    return
+        pType &&
+        !pType->IsBad() &&
+        !pType->IsGenericBinding() &&
+        (pType->IsClass() || pType->IsInterface()) &&
+        !pType->PContainer()->IsTransient();
+}
+
 /*=======================================================================================
 ClassifyConversion
 
@@ -252,6 +267,109 @@ Semantics::ClassifyConversion
     DelegateRelaxationLevel * pConversionRelaxationLevel,
     bool IgnoreOperatorMethod
 )
+{
+    // Conversions between intrinsic types are a table lookup, which is cheaper
+    // than the cache.
+    if (!m_PermitDeclarationCaching ||
+        !m_ConversionCache ||
+        TargetType == SourceType ||
+        !IsConversionCacheable(TargetType) ||
+        !IsConversionCacheable(SourceType) ||
+        (TargetType->GetVtype() < t_ref && SourceType->GetVtype() < t_ref))
+    {
+        return
+            ClassifyUncachedConversion
+            (
+                TargetType,
+                SourceType,
+                OperatorMethod,
+                OperatorMethodGenericContext,
+                OperatorMethodIsLifted,
+                considerConversionsOnNullableBool,
+                pConversionRequiresUnliftedAccessToNullableValue,
+                pConversionIsNarrowingDueToAmbiguity,
+                pConversionRelaxationLevel,
+                IgnoreOperatorMethod
+            );
+    }
+
+    ConversionClassificationCache::Classification Cached;
+
+    if (m_ConversionCache->LookupInCache(TargetType, SourceType, considerConversionsOnNullableBool, IgnoreOperatorMethod, &Cached))
+    {
+        OperatorMethod = Cached.pOperatorMethod;
+        OperatorMethodGenericContext = NULL;
+        OperatorMethodIsLifted = false;
+    }
+    else
+    {
+        bool RequiresUnliftedAccessToNullableValue = false;
+        bool IsNarrowingDueToAmbiguity = false;
+        DelegateRelaxationLevel RelaxationLevel = DelegateRelaxationLevelNone;
+
+        OperatorMethod = NULL;
+        OperatorMethodGenericContext = NULL;
+
+        Cached.Result =
+            ClassifyUncachedConversion
+            (
+                TargetType,
+                SourceType,
+                OperatorMethod,
+                OperatorMethodGenericContext,
+                OperatorMethodIsLifted,
+                considerConversionsOnNullableBool,
+                &RequiresUnliftedAccessToNullableValue,
+                &IsNarrowingDueToAmbiguity,
+                &RelaxationLevel,
+                IgnoreOperatorMethod
+            );
+
+        Cached.pOperatorMethod = OperatorMethod;
+        Cached.RelaxationLevel = RelaxationLevel;
+        Cached.RequiresUnliftedAccessToNullableValue = RequiresUnliftedAccessToNullableValue;
+        Cached.IsNarrowingDueToAmbiguity = IsNarrowingDueToAmbiguity;
+
+        // An operator found through a generic binding (one inherited from a
+        // generic base class, say) is only good for as long as the binding is.
+        if (!OperatorMethodGenericContext && !OperatorMethodIsLifted)
+        {
+            m_ConversionCache->AddEntry(TargetType, SourceType, considerConversionsOnNullableBool, IgnoreOperatorMethod, Cached);
+        }
+    }
+
+    if (pConversionRequiresUnliftedAccessToNullableValue)
+    {
+        *pConversionRequiresUnliftedAccessToNullableValue = Cached.RequiresUnliftedAccessToNullableValue;
+    }
+
+    if (pConversionIsNarrowingDueToAmbiguity)
+    {
+        *pConversionIsNarrowingDueToAmbiguity = Cached.IsNarrowingDueToAmbiguity;
+    }
+
+    if (pConversionRelaxationLevel)
+    {
+        *pConversionRelaxationLevel = (DelegateRelaxationLevel)Cached.RelaxationLevel;
+    }
+
+    return (ConversionClass)Cached.Result;
+}
+
+ConversionClass
+Semantics::ClassifyUncachedConversion
+(
+    Type *TargetType,
+    Type *SourceType,
+    Procedure *&OperatorMethod,
+    GenericBinding *&OperatorMethodGenericContext,
+    bool &OperatorMethodIsLifted,
+    bool considerConversionsOnNullableBool,
+    bool * pConversionRequiresUnliftedAccessToNullableValue,
+    bool * pConversionIsNarrowingDueToAmbiguity,
+    DelegateRelaxationLevel * pConversionRelaxationLevel,
+    bool IgnoreOperatorMethod
+)
 {
 
     ConversionClass Result =
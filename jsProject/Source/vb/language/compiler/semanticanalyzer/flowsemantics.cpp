@@ -24,16 +24,24 @@ public:
     Semantics *m_Semantics;
     bool m_IncludeLocals;
     bool m_IncludeReturns;
+    DynamicHashTable<ILTree::PILNode, unsigned> *m_StatementOrder;
+    unsigned m_NextStatementOrder;
 
     DefAsgBlockVisitor(Semantics* semantics) :
-       m_Semantics(semantics)
+       m_Semantics(semantics),
+       m_StatementOrder(NULL),
+       m_NextStatementOrder(0)
     {
     }
 
-    void Visit(ILTree::ProcedureBlock *body, bool IncludeLocals, bool IncludeReturns)
+    // If StatementOrder is given, it receives the pre-order number of every statement.
+    void Visit(ILTree::ProcedureBlock *body, bool IncludeLocals, bool IncludeReturns,
+               DynamicHashTable<ILTree::PILNode, unsigned> *StatementOrder = NULL)
     {
         m_IncludeLocals = IncludeLocals;
         m_IncludeReturns = IncludeReturns;
+        m_StatementOrder = StatementOrder;
+        m_NextStatementOrder = 0;
         BoundTreeVisitor::Visit(body);
     }
 
@@ -60,6 +68,11 @@ public:
             return false;
         }
 
+        if (m_StatementOrder)
+        {
+            m_StatementOrder->SetValue(statement, m_NextStatementOrder++);
+        }
+
         switch (statement->bilop)
         {
             case SL_EXIT:
@@ -80,6 +93,147 @@ public:
 
 };
 
+// DefAsgReEvalHeap: the re-evaluations pending in worklist order (see IsDefAsgWorklistOrder),
+// in a min-heap on the pre-order number of their statements, which DefAsgBlockVisitor fills
+// in; ties are taken in the order they were queued.  A statement is pending at most once,
+// as in DefAsgReEvalStmtList.  Removing it leaves its heap entry behind, to be dropped when
+// it reaches the top.
+class DefAsgReEvalHeap
+{
+public:
+    DefAsgReEvalHeap() : m_NextSequence(0) {}
+
+    DynamicHashTable<ILTree::PILNode, unsigned> *GetStatementOrder()
+    {
+        return &m_StatementOrder;
+    }
+
+    bool IsEmpty()
+    {
+        return m_Pending.Count() == 0;
+    }
+
+    void Add(ILTree::PILNode stmt, unsigned int ClosureDepth, NorlsAllocator *allocator)
+    {
+        if (stmt == NULL || m_Pending.Contains(stmt))
+        {
+            return;
+        }
+
+        DefAsgReEvalStmt *ReEval = (DefAsgReEvalStmt *)allocator->Alloc(sizeof(DefAsgReEvalStmt));
+        ReEval->m_ReEvalStmt = stmt;
+        ReEval->ClosureDepth = ClosureDepth;
+        m_Pending.SetValue(stmt, ReEval);
+
+        Entry &entry = m_Heap.Add();
+        entry.m_Order = m_StatementOrder.GetValueOrDefault(stmt, UINT_MAX);
+        entry.m_Sequence = m_NextSequence++;
+        entry.m_ReEval = ReEval;
+        SiftUp(m_Heap.Count() - 1);
+    }
+
+    void Remove(ILTree::PILNode stmt)
+    {
+        if (stmt != NULL)
+        {
+            m_Pending.Remove(stmt);
+        }
+    }
+
+    DefAsgReEvalStmt *TakeFirst()
+    {
+        VSASSERT(!IsEmpty(), "No re-evaluation pending.");
+
+        for (;;)
+        {
+            DefAsgReEvalStmt *ReEval = m_Heap.Element(0).m_ReEval;
+
+            m_Heap.Element(0) = m_Heap.Element(m_Heap.Count() - 1);
+            m_Heap.Shrink();
+
+            if (m_Heap.Count() > 0)
+            {
+                SiftDown(0);
+            }
+
+            // Skip entries whose statement was removed, or removed and queued again.
+            if (m_Pending.GetValueOrDefault(ReEval->m_ReEvalStmt, NULL) == ReEval)
+            {
+                m_Pending.Remove(ReEval->m_ReEvalStmt);
+                return ReEval;
+            }
+        }
+    }
+
+private:
+    struct Entry
+    {
+        unsigned m_Order;
+        unsigned m_Sequence;
+        DefAsgReEvalStmt *m_ReEval;
+    };
+
+    bool IsBefore(unsigned i, unsigned j)
+    {
+        Entry &left = m_Heap.Element(i);
+        Entry &right = m_Heap.Element(j);
+
+        return left.m_Order < right.m_Order ||
+               (left.m_Order == right.m_Order && left.m_Sequence < right.m_Sequence);
+    }
+
+    void Swap(unsigned i, unsigned j)
+    {
+        Entry temp = m_Heap.Element(i);
+        m_Heap.Element(i) = m_Heap.Element(j);
+        m_Heap.Element(j) = temp;
+    }
+
+    void SiftUp(unsigned i)
+    {
+        while (i > 0 && IsBefore(i, (i - 1) / 2))
+        {
+            Swap(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void SiftDown(unsigned i)
+    {
+        unsigned count = m_Heap.Count();
+
+        for (;;)
+        {
+            unsigned first = i;
+            unsigned left = 2 * i + 1;
+            unsigned right = left + 1;
+
+            if (left < count && IsBefore(left, first))
+            {
+                first = left;
+            }
+
+            if (right < count && IsBefore(right, first))
+            {
+                first = right;
+            }
+
+            if (first == i)
+            {
+                return;
+            }
+
+            Swap(i, first);
+            i = first;
+        }
+    }
+
+    DynamicHashTable<ILTree::PILNode, unsigned> m_StatementOrder;
+    DynamicHashTable<ILTree::PILNode, DefAsgReEvalStmt *> m_Pending;
+    DynamicArray<Entry> m_Heap;
+    unsigned m_NextSequence;
+};
+
 // DefAsgUnusedVisitor: used to iterate executable blocks and multiline lambdas, and check whether they were unused:
 class DefAsgUnusedVisitor : public BoundTreeVisitor 
 {
@@ -180,124 +334,25 @@ void Semantics::CheckFlow(ILTree::ProcedureBlock *BoundBody, bool OnlyCheckRetur
 #endif
 	VSASSERT(m_DefAsgCount==0, "unexpected: m_DefAstCount should have been zero. If it's not, there might be slotted variables lying around somewhere...");
 	m_DefAsgCount=0;
+    DefAsgReEvalHeap ReEvalHeap;
+    DefAsgReEvalHeap *PreviousReEvalHeap = m_DefAsgReEvalHeap;
+    m_DefAsgReEvalHeap = IsDefAsgWorklistOrder() ? &ReEvalHeap : NULL;
+    bool NoRetValReported = m_ProcedureTree->AsProcedureBlock().fDefAsgNoRetValReported;
     DefAsgBlockVisitor blockVisitor(this);
-    blockVisitor.Visit(BoundBody, !OnlyCheckReturns/*slots for locals?*/, CheckForReturns/*slots for returns?*/);
-    // this calls DefAsgProcessSlots(block) for each executable block in BoundBody, which
-    // sets up slots in the m_DefAsgCount array and sets pvar->DefAsgSlot;
-    // It also sets inDefAsgBitset and outDefAsgBitset to NULL for all blocks, in case the body had been
-    // examined before.
-
-    m_DefAsgErrorDisplayedBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
-    m_DefAsgCurrentBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
-    BoundBody->inDefAsgBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
-    m_DefAsgTempBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
-    m_DefAsgIsReachableCode = true;
 
-
-    // Flow analysis: initial run
-    DBG_SWITCH_PRINTF(fDumpFlow, L"CheckFlow:Eval: %s.%s  {CURBITSET=%08x}\n", PhysicalContainer->GetName(), m_Procedure->GetName(), m_DefAsgCurrentBitset);
-    DefAsgEvalBlock(BoundBody,0);
-
-    // Flow analysis: if there had been cycles in the flow graph, then we keep evaluating them until
-    // we reach a fixed point
-    ILTree::PILNode currentReEvalStmt;
-    while (m_DefAsgReEvalStmtList.NumberOfEntries()>0)
+    if (DefAsgSolve(BoundBody, !OnlyCheckReturns, CheckForReturns, true /* ReportInitialRun */))
     {
-        DefAsgReEvalStmt* top = m_DefAsgReEvalStmtList.GetFirst();
-        currentReEvalStmt = top->m_ReEvalStmt;
-        unsigned int ClosureDepth = top->ClosureDepth;
-        m_DefAsgReEvalStmtList.Remove(top);
-        if (currentReEvalStmt->bilop == SL_LABEL)
-        {
-            // the re eval point is a label. There is a current bitset and it is reachable
-            ILTree::LabelStatement *label = &currentReEvalStmt->AsLabelStatement();
-            DBG_SWITCH_PRINTF(fDumpFlow, L"--re-eval %S  {inBITSET=%08x}\n", ILTree::BilopName(label->bilop), label->inDefAsgBitset);
-            m_DefAsgCurrentBitset = m_DefAsgCurrentBitset->setInto(label->inDefAsgBitset, &m_DefAsgAllocator);
-            m_DefAsgIsReachableCode = true;
-        }
-        else if  (currentReEvalStmt->IsExecutableBlockNode())
-        {
-            // an executable block in the re-eval list can be introduced by 'exit/break'. The sequence following the
-            // block is re evaluated based on the out-bitset of the block
-            ILTree::ExecutableBlock* block = &currentReEvalStmt->AsExecutableBlock();
-            DBG_SWITCH_PRINTF(fDumpFlow, L"--re-eval %S  {outBITSET=%08x}\n", ILTree::BilopName(block->bilop), block->outDefAsgBitset);
-
-            if (block->bilop == SB_TRY)
-            {
-                // 'try,catch,finally' nodes are considered as a group statement
-                if (block->AsTryBlock().outDefAsgBitsetTryGroup)
-                {
-                    m_DefAsgCurrentBitset = m_DefAsgCurrentBitset->setInto(block->AsTryBlock().outDefAsgBitsetTryGroup);
-                    m_DefAsgIsReachableCode = true;
-
-                    // move to the end of the group
-                    while(block->Next != NULL &&
-                          (block->Next->bilop == SB_CATCH || block->Next->bilop == SB_FINALLY))
-                    {
-                        block = &block->Next->AsExecutableBlock();
-                    }
-                    if (block->Next != NULL)
-                    {
-                        currentReEvalStmt = block->Next;
-                    }
-                    else
-                    {
-                        // the group is the last stmt in the enclosing block
-                        currentReEvalStmt = DefAsgUpdateParentGetContinuation(currentReEvalStmt, ClosureDepth);
-                    }
-                }
-                else
-                {
-                    VSFAIL("Definite assignment: how a block re eval without out-bitset?");
-                    currentReEvalStmt = NULL;
-                }
-
-            }
-            else
-            {
-                //other block than try or catch
-                if (block->outDefAsgBitset)
-                {
-                    m_DefAsgCurrentBitset = m_DefAsgCurrentBitset->setInto(block->outDefAsgBitset);
-                    m_DefAsgIsReachableCode = true;
-                    if (block->Next  != NULL)
-                    {
-                        currentReEvalStmt = block->Next;
-                    }
-                    else
-                    {
-                        currentReEvalStmt = DefAsgUpdateParentGetContinuation(currentReEvalStmt, ClosureDepth);
-                    }
-                }
-                else
-                {
-
-                    VSFAIL("Definite assignment: how a block re eval without out-bitset?");
-                    currentReEvalStmt = NULL;
-                }
-            }
-        }
-        else
-        {
-            // land nicely for now, to change to asserts lately.
-            VSFAIL("Definite assignment: why were we asked to re-evaluate a non-label non-block?");
-            currentReEvalStmt = NULL;
-        }
-
-
-        // re eval the statement list started by currentReEvalStmt,
-        // then walk up the block structure for its continuation and re eval it
-        // THe process stops when the code become unreachable, or the chages introduced by re eval become local
-        //
-        while (currentReEvalStmt != NULL)
-        {
-            DefAsgEvalStatementList(currentReEvalStmt, ClosureDepth);
-            currentReEvalStmt = DefAsgUpdateParentGetContinuation(currentReEvalStmt, ClosureDepth);
-        }
-
-        DBG_SWITCH_PRINTF(fDumpFlow, L"  finished re-eval.  {CURBITSET=%08x}\n",m_DefAsgCurrentBitset);
-
-    } // next re eval stmt list
+        // The worklist order reaches the same fixed point, so it finds the same
+        // variables used before assignment, but its re-evaluations can reach them
+        // at other uses first and so report nothing.  They found some: solve again
+        // in the default order, reporting only what its re-evaluations find, so the
+        // diagnostics are exactly those of the default order.
+        blockVisitor.Visit(BoundBody, false, false);
+        m_DefAsgReEvalHeap = NULL;
+        m_DefAsgOnErrorSeen = false;
+        m_ProcedureTree->AsProcedureBlock().fDefAsgNoRetValReported = NoRetValReported;
+        DefAsgSolve(BoundBody, !OnlyCheckReturns, CheckForReturns, false /* ReportInitialRun */);
+    }
 
     //check for functions without return value
     if ( !m_DefAsgOnErrorSeen )
@@ -425,9 +480,242 @@ void Semantics::CheckFlow(ILTree::ProcedureBlock *BoundBody, bool OnlyCheckRetur
 
     blockVisitor.Visit(BoundBody, false, false);
 	m_DefAsgCount=0;
+    m_DefAsgReEvalHeap = PreviousReEvalHeap;
 
 }
 
+// Sets up the slots of BoundBody and runs the flow analysis to its fixed point,
+// reporting uses before assignment as they are found; the initial run reports only
+// if ReportInitialRun.  In worklist order (m_DefAsgReEvalHeap is set) the
+// re-evaluations report nothing, and the result is whether they would have.
+bool Semantics::DefAsgSolve(ILTree::ProcedureBlock *BoundBody, bool IncludeLocals, bool IncludeReturns, bool ReportInitialRun)
+{
+    m_DefAsgCount=0;
+    DefAsgBlockVisitor blockVisitor(this);
+    blockVisitor.Visit(BoundBody, IncludeLocals/*slots for locals?*/, IncludeReturns/*slots for returns?*/,
+                       m_DefAsgReEvalHeap ? m_DefAsgReEvalHeap->GetStatementOrder() : NULL);
+    // this calls DefAsgProcessSlots(block) for each executable block in BoundBody, which
+    // sets up slots in the m_DefAsgCount array and sets pvar->DefAsgSlot;
+    // It also sets inDefAsgBitset and outDefAsgBitset to NULL for all blocks, in case the body had been
+    // examined before.
+
+    m_DefAsgErrorDisplayedBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
+    m_DefAsgCurrentBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
+    BoundBody->inDefAsgBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
+    m_DefAsgTempBitset = BITSET::create(m_DefAsgCount, &m_DefAsgAllocator, 0);
+    m_DefAsgIsReachableCode = true;
+
+
+    // Flow analysis: initial run
+    DBG_SWITCH_PRINTF(fDumpFlow, L"CheckFlow:Eval: %s.%s  {CURBITSET=%08x}\n", m_Procedure->GetPhysicalContainer()->GetName(), m_Procedure->GetName(), m_DefAsgCurrentBitset);
+    bool ReportErrors = m_ReportErrors;
+    m_ReportErrors = ReportErrors && ReportInitialRun;
+    DefAsgEvalBlock(BoundBody,0);
+
+    // In worklist order the re-evaluations only note what they would report.
+    BITSET *InitialErrorDisplayedBitset = NULL;
+    bool InitialNoRetValReported = m_ProcedureTree->AsProcedureBlock().fDefAsgNoRetValReported;
+    if (m_DefAsgReEvalHeap)
+    {
+        InitialErrorDisplayedBitset = BITSET::createCopy(m_DefAsgErrorDisplayedBitset, &m_DefAsgAllocator);
+        m_ReportErrors = false;
+    }
+    else
+    {
+        m_ReportErrors = ReportErrors;
+    }
+
+    // Flow analysis: if there had been cycles in the flow graph, then we keep evaluating them until
+    // we reach a fixed point
+    ILTree::PILNode currentReEvalStmt;
+    while (DefAsgHasReEvalStmts())
+    {
+        DefAsgReEvalStmt* top = DefAsgTakeNextReEvalStmt();
+        currentReEvalStmt = top->m_ReEvalStmt;
+        unsigned int ClosureDepth = top->ClosureDepth;
+        TIMERCOUNT(COUNT_DefAsgReEvals, 1);
+        if (currentReEvalStmt->bilop == SL_LABEL)
+        {
+            // the re eval point is a label. There is a current bitset and it is reachable
+            ILTree::LabelStatement *label = &currentReEvalStmt->AsLabelStatement();
+            DBG_SWITCH_PRINTF(fDumpFlow, L"--re-eval %S  {inBITSET=%08x}\n", ILTree::BilopName(label->bilop), label->inDefAsgBitset);
+            m_DefAsgCurrentBitset = m_DefAsgCurrentBitset->setInto(label->inDefAsgBitset, &m_DefAsgAllocator);
+            m_DefAsgIsReachableCode = true;
+        }
+        else if  (currentReEvalStmt->IsExecutableBlockNode())
+        {
+            // an executable block in the re-eval list can be introduced by 'exit/break'. The sequence following the
+            // block is re evaluated based on the out-bitset of the block
+            ILTree::ExecutableBlock* block = &currentReEvalStmt->AsExecutableBlock();
+            DBG_SWITCH_PRINTF(fDumpFlow, L"--re-eval %S  {outBITSET=%08x}\n", ILTree::BilopName(block->bilop), block->outDefAsgBitset);
+
+            if (block->bilop == SB_TRY)
+            {
+                // 'try,catch,finally' nodes are considered as a group statement
+                if (block->AsTryBlock().outDefAsgBitsetTryGroup)
+                {
+                    m_DefAsgCurrentBitset = m_DefAsgCurrentBitset->setInto(block->AsTryBlock().outDefAsgBitsetTryGroup);
+                    m_DefAsgIsReachableCode = true;
+
+                    // move to the end of the group
+                    while(block->Next != NULL &&
+                          (block->Next->bilop == SB_CATCH || block->Next->bilop == SB_FINALLY))
+                    {
+                        block = &block->Next->AsExecutableBlock();
+                    }
+                    if (block->Next != NULL)
+                    {
+                        currentReEvalStmt = block->Next;
+                    }
+                    else
+                    {
+                        // the group is the last stmt in the enclosing block
+                        currentReEvalStmt = DefAsgUpdateParentGetContinuation(currentReEvalStmt, ClosureDepth);
+                    }
+                }
+                else
+                {
+                    VSFAIL("Definite assignment: how a block re eval without out-bitset?");
+                    currentReEvalStmt = NULL;
+                }
+
+            }
+            else
+            {
+                //other block than try or catch
+                if (block->outDefAsgBitset)
+                {
+                    m_DefAsgCurrentBitset = m_DefAsgCurrentBitset->setInto(block->outDefAsgBitset);
+                    m_DefAsgIsReachableCode = true;
+                    if (block->Next  != NULL)
+                    {
+                        currentReEvalStmt = block->Next;
+                    }
+                    else
+                    {
+                        currentReEvalStmt = DefAsgUpdateParentGetContinuation(currentReEvalStmt, ClosureDepth);
+                    }
+                }
+                else
+                {
+
+                    VSFAIL("Definite assignment: how a block re eval without out-bitset?");
+                    currentReEvalStmt = NULL;
+                }
+            }
+        }
+        else
+        {
+            // land nicely for now, to change to asserts lately.
+            VSFAIL("Definite assignment: why were we asked to re-evaluate a non-label non-block?");
+            currentReEvalStmt = NULL;
+        }
+
+
+        // re eval the statement list started by currentReEvalStmt,
+        // then walk up the block structure for its continuation and re eval it
+        // THe process stops when the code become unreachable, or the chages introduced by re eval become local
+        //
+        while (currentReEvalStmt != NULL)
+        {
+            DefAsgEvalStatementList(currentReEvalStmt, ClosureDepth);
+            currentReEvalStmt = DefAsgUpdateParentGetContinuation(currentReEvalStmt, ClosureDepth);
+        }
+
+        DBG_SWITCH_PRINTF(fDumpFlow, L"  finished re-eval.  {CURBITSET=%08x}\n",m_DefAsgCurrentBitset);
+
+    } // next re eval stmt list
+
+    m_ReportErrors = ReportErrors;
+
+    return ReportErrors &&
+           InitialErrorDisplayedBitset &&
+           (!m_DefAsgErrorDisplayedBitset->isEqual(InitialErrorDisplayedBitset) ||
+            m_ProcedureTree->AsProcedureBlock().fDefAsgNoRetValReported != InitialNoRetValReported);
+}
+
+// Setting VBC_DEFASG_WORKLIST makes CheckFlow take the pending re-evaluations
+// earliest statement first, rather than in the order they were queued.  This is
+// only an experiment in reordering the existing solver, not a block-level one:
+// each re-evaluation still runs the rest of its statement list and walks up
+// through DefAsgUpdateParentGetContinuation as before.
+//
+// Structured flow only goes backwards through loops and gotos, so statement
+// pre-order is a reverse postorder of the flow graph and taking the earliest
+// pending re-evaluation first lets the changes from a back edge reach the
+// statements after it in one pass, instead of one pass per queued point.  Both
+// orders reach the same fixed point and CheckFlow reports what the default order
+// would, but a body whose re-evaluations find a use before assignment is solved
+// a second time in the default order to get its diagnostics, so the switch can
+// be slower than the default.  It is there to compare timings on large
+// generated methods.
+//
+// The variable is read once per process.
+static volatile LONG s_DefAsgWorklistOrder = -1;
+
+bool Semantics::IsDefAsgWorklistOrder()
+{
+    LONG WorklistOrder = s_DefAsgWorklistOrder;
+
+    if (WorklistOrder < 0)
+    {
+        // Racing threads all read the same value.
+        const LPCWSTR wszEnvironmentVar = L"VBC_DEFASG_WORKLIST";
+        WorklistOrder = GetEnvironmentVariableW(wszEnvironmentVar, NULL, 0) != 0;
+        s_DefAsgWorklistOrder = WorklistOrder;
+    }
+
+    return WorklistOrder != 0;
+}
+
+// Removes and returns the re-evaluation CheckFlow should do next.
+DefAsgReEvalStmt * Semantics::DefAsgTakeNextReEvalStmt()
+{
+    if (m_DefAsgReEvalHeap)
+    {
+        return m_DefAsgReEvalHeap->TakeFirst();
+    }
+
+    VSASSERT(m_DefAsgReEvalStmtList.NumberOfEntries() > 0, "No re-evaluation pending.");
+
+    DefAsgReEvalStmt * next = m_DefAsgReEvalStmtList.GetFirst();
+    m_DefAsgReEvalStmtList.Remove(next);
+    return next;
+}
+
+// Queues a re-evaluation of stmt, unless one is already pending.
+void Semantics::DefAsgAddReEvalStmt(ILTree::PILNode stmt, unsigned int ClosureDepth)
+{
+    if (m_DefAsgReEvalHeap)
+    {
+        m_DefAsgReEvalHeap->Add(stmt, ClosureDepth, &m_DefAsgAllocator);
+    }
+    else
+    {
+        m_DefAsgReEvalStmtList.AddReEvalStmt(stmt, ClosureDepth, &m_DefAsgAllocator);
+    }
+}
+
+// Drops the pending re-evaluation of stmt, if any.
+void Semantics::DefAsgRemoveReEvalStmt(ILTree::PILNode stmt)
+{
+    if (m_DefAsgReEvalHeap)
+    {
+        m_DefAsgReEvalHeap->Remove(stmt);
+    }
+    else
+    {
+        m_DefAsgReEvalStmtList.RemoveReEvalStmt(stmt);
+    }
+}
+
+bool Semantics::DefAsgHasReEvalStmts()
+{
+    return m_DefAsgReEvalHeap ?
+        !m_DefAsgReEvalHeap->IsEmpty() :
+        m_DefAsgReEvalStmtList.NumberOfEntries() > 0;
+}
+
 
 // Start with the current bitset and the current reachabble flag, run the list
 // and let the output bitset and reachable flag in
@@ -475,7 +763,7 @@ Semantics::DefAsgEvalStatementList
                     prevStmt = GetTryBlockInTryGroup(prevStmt);
                 }
 
-                this->m_DefAsgReEvalStmtList.RemoveReEvalStmt(prevStmt);
+                DefAsgRemoveReEvalStmt(prevStmt);
             }
         }
 
@@ -693,12 +981,12 @@ RET_EXIT:
                             ILTree::TryBlock* pTry = DefAsgUpdateTryGroupOutBitSet(targetBlock, &isBitSetChanged);
                             if (isBitSetChanged)
                             {
-                                m_DefAsgReEvalStmtList.AddReEvalStmt(pTry, ClosureDepth, &m_DefAsgAllocator);
+                                DefAsgAddReEvalStmt(pTry, ClosureDepth);
                             }
                         }
                         else
                         {
-                            m_DefAsgReEvalStmtList.AddReEvalStmt(targetBlock, ClosureDepth, &m_DefAsgAllocator);
+                            DefAsgAddReEvalStmt(targetBlock, ClosureDepth);
                         }
                     }
                 }
@@ -777,7 +1065,7 @@ RET_EXIT:
                         &m_DefAsgAllocator);
                     if (isLabelBitSetChanged)
                     {
-                        m_DefAsgReEvalStmtList.AddReEvalStmt(&labelNode, ClosureDepth, &m_DefAsgAllocator);
+                        DefAsgAddReEvalStmt(&labelNode, ClosureDepth);
                     }
                 }
 
@@ -799,7 +1087,7 @@ RET_EXIT:
             {
                 // this label node is curently evaluated but also it might be in the list for re eval
                 // it can safely removed and avoid an unecessary re eval
-                this->m_DefAsgReEvalStmtList.RemoveReEvalStmt(ptreeStmtCur);
+                DefAsgRemoveReEvalStmt(ptreeStmtCur);
 
                 // label reached by fallthrough, ( possiblly by previous go to as well)
                 // if there is a previous in-bitset for the label, join(and) it to the current bitset
@@ -2824,7 +3112,7 @@ void Semantics::UpdateLabelOrBlockAcrossTryCatch( ILTree::PILNode gotoOrExitNode
 
         if (isTargetBitSetChanged)
         {
-            m_DefAsgReEvalStmtList.AddReEvalStmt(targetStmt, ClosureDepth, &m_DefAsgAllocator);
+            DefAsgAddReEvalStmt(targetStmt, ClosureDepth);
         }
     }
 }
@@ -3075,6 +3363,181 @@ void Semantics::ReportDefAsgNoRetVal(Procedure *procedure, Type *pRetVarType, Lo
 #define BIT_MASK BITSET_BIT_MASK        // This is how many bits can go in a 'slot'
 #define MAX_SIZE BITSET_MAX_SIZE        // This is the size of a 'slot'
 
+//
+// Word kernels for the large bitsets.  Definite assignment of a method with
+// thousands of locals spends its time and-ing, or-ing and copying these, so on
+// x86 and x64 they work a 128-bit SSE2 register at a time and finish off the
+// odd word with the scalar loop.  Bit arrays come from NorlsAllocators and
+// aren't 16-byte aligned, so the loads and stores are unaligned.  The "changed"
+// masks are accumulated in the register and folded at the end, giving the same
+// mask the word-at-a-time loops gave.
+//
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define BITSET_SSE2 1
+#endif
+
+#if BITSET_SSE2
+
+#include <emmintrin.h>
+
+// Number of DWORD_PTRs processed per SSE2 step.
+const size_t BitsetSseBlockWidth = sizeof(__m128i) / sizeof(DWORD_PTR);
+
+// Ors the DWORD_PTR lanes of Block together.
+inline DWORD_PTR
+FoldLanes
+(
+    __m128i Block
+)
+{
+    DWORD_PTR Lanes[BitsetSseBlockWidth];
+    _mm_storeu_si128((__m128i *)Lanes, Block);
+
+    DWORD_PTR Result = 0;
+    for (size_t i = 0; i < BitsetSseBlockWidth; i++)
+    {
+        Result |= Lanes[i];
+    }
+    return Result;
+}
+
+#endif // BITSET_SSE2
+
+// Dest |= Source.
+static void
+OrWords
+(
+    _Inout_count_(Count) DWORD_PTR * Dest,
+    _In_count_(Count) const DWORD_PTR * Source,
+    size_t Count
+)
+{
+    size_t i = 0;
+
+#if BITSET_SSE2
+    for (; i + BitsetSseBlockWidth <= Count; i += BitsetSseBlockWidth)
+    {
+        __m128i Block = _mm_loadu_si128((const __m128i *)(Dest + i));
+        Block = _mm_or_si128(Block, _mm_loadu_si128((const __m128i *)(Source + i)));
+        _mm_storeu_si128((__m128i *)(Dest + i), Block);
+    }
+#endif // BITSET_SSE2
+
+    for (; i < Count; i++)
+    {
+        Dest[i] |= Source[i];
+    }
+}
+
+// Dest &= Source.  Returns the bits that were cleared in any word of Dest.
+static DWORD_PTR
+AndWords
+(
+    _Inout_count_(Count) DWORD_PTR * Dest,
+    _In_count_(Count) const DWORD_PTR * Source,
+    size_t Count
+)
+{
+    size_t i = 0;
+    DWORD_PTR Changed = 0;
+
+#if BITSET_SSE2
+    __m128i ChangedBlock = _mm_setzero_si128();
+
+    for (; i + BitsetSseBlockWidth <= Count; i += BitsetSseBlockWidth)
+    {
+        __m128i Saved = _mm_loadu_si128((const __m128i *)(Dest + i));
+        __m128i SourceBlock = _mm_loadu_si128((const __m128i *)(Source + i));
+
+        // The cleared bits, Saved & ~Source, are the ones Saved & ~(Saved & Source) gives.
+        ChangedBlock = _mm_or_si128(ChangedBlock, _mm_andnot_si128(SourceBlock, Saved));
+        _mm_storeu_si128((__m128i *)(Dest + i), _mm_and_si128(Saved, SourceBlock));
+    }
+
+    Changed = FoldLanes(ChangedBlock);
+#endif // BITSET_SSE2
+
+    for (; i < Count; i++)
+    {
+        DWORD_PTR Saved = Dest[i];
+        Dest[i] &= Source[i];
+        Changed |= Saved & ~Dest[i];
+    }
+
+    return Changed;
+}
+
+// Dest = Source.  Returns whether any word of Dest changed.
+static bool
+CopyWords
+(
+    _Inout_count_(Count) DWORD_PTR * Dest,
+    _In_count_(Count) const DWORD_PTR * Source,
+    size_t Count
+)
+{
+    size_t i = 0;
+    DWORD_PTR Changed = 0;
+
+#if BITSET_SSE2
+    __m128i ChangedBlock = _mm_setzero_si128();
+
+    for (; i + BitsetSseBlockWidth <= Count; i += BitsetSseBlockWidth)
+    {
+        __m128i SourceBlock = _mm_loadu_si128((const __m128i *)(Source + i));
+
+        ChangedBlock =
+            _mm_or_si128(
+                ChangedBlock,
+                _mm_xor_si128(SourceBlock, _mm_loadu_si128((const __m128i *)(Dest + i))));
+        _mm_storeu_si128((__m128i *)(Dest + i), SourceBlock);
+    }
+
+    Changed = FoldLanes(ChangedBlock);
+#endif // BITSET_SSE2
+
+    for (; i < Count; i++)
+    {
+        Changed |= Dest[i] ^ Source[i];
+        Dest[i] = Source[i];
+    }
+
+    return Changed != 0;
+}
+
+static bool
+AreWordsZero
+(
+    _In_count_(Count) const DWORD_PTR * Words,
+    size_t Count
+)
+{
+    size_t i = 0;
+
+#if BITSET_SSE2
+    for (; i + BitsetSseBlockWidth <= Count; i += BitsetSseBlockWidth)
+    {
+        __m128i Block = _mm_loadu_si128((const __m128i *)(Words + i));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(Block, _mm_setzero_si128())) != 0xFFFF)
+        {
+            return false;
+        }
+    }
+#endif // BITSET_SSE2
+
+    for (; i < Count; i++)
+    {
+        if (Words[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 BITSET * __fastcall BITSET::setBit(unsigned bit)
 {
     if (((DWORD_PTR)this) & 1) {
@@ -3185,11 +3648,7 @@ bool __fastcall BITSET::isZero()
 bool __fastcall BITSET::isZeroLarge()
 {
     BITSETIMP * bitset = (BITSETIMP*)this;
-    DWORD_PTR * thisDword = bitset->bitArray;
-    do {
-        if (*(thisDword++)) return false;
-    } while (thisDword != bitset->arrayEnd);
-    return true;
+    return AreWordsZero(bitset->bitArray, bitset->arrayEnd - bitset->bitArray);
 }
 
 
@@ -3317,11 +3776,7 @@ BITSET * __fastcall BITSET::orInto(BITSET * source)
 BITSET * __fastcall BITSET::orIntoLarge(BITSET * source)
 {
     BITSETIMP * bitset = (BITSETIMP*)this;
-    DWORD_PTR * thisDword = bitset->bitArray;
-    DWORD_PTR * sourceDword = ((BITSETIMP*)source)->bitArray;
-    do {
-        *(thisDword++) |= *(sourceDword++);
-    } while (thisDword != bitset->arrayEnd);
+    OrWords(bitset->bitArray, ((BITSETIMP*)source)->bitArray, bitset->arrayEnd - bitset->bitArray);
     return this;
 }
 
@@ -3345,14 +3800,8 @@ BITSET * __fastcall BITSET::orInto(BITSET * source, DWORD_PTR * changed)
 BITSET * __fastcall BITSET::orIntoLarge(BITSET * source, DWORD_PTR * changed)
 {
     BITSETIMP * bitset = (BITSETIMP*)this;
-    DWORD_PTR * thisDword = bitset->bitArray;
-    DWORD_PTR * sourceDword = ((BITSETIMP*)source)->bitArray;
-    *changed = 0;
-    do {
-        DWORD_PTR saved = *thisDword;   // save the old bits
-        *thisDword |= *(sourceDword++); // compute the new bits
-        *changed |= (saved & ~*(thisDword++));    // extinguished bits are those in old which are not in new
-    } while (thisDword != bitset->arrayEnd);
+    OrWords(bitset->bitArray, ((BITSETIMP*)source)->bitArray, bitset->arrayEnd - bitset->bitArray);
+    *changed = 0;   // extinguished bits are those in old which are not in new; or-ing extinguishes none
     return this;
 }
 
@@ -3375,11 +3824,7 @@ BITSET * __fastcall BITSET::andInto(BITSET * source)
 BITSET * __fastcall BITSET::andIntoLarge(BITSET * source)
 {
     BITSETIMP * bitset = (BITSETIMP*)this;
-    DWORD_PTR * thisDword = bitset->bitArray;
-    DWORD_PTR * sourceDword = ((BITSETIMP*)source)->bitArray;
-    do {
-        *(thisDword++) &= *(sourceDword++);
-    } while (thisDword != bitset->arrayEnd);
+    AndWords(bitset->bitArray, ((BITSETIMP*)source)->bitArray, bitset->arrayEnd - bitset->bitArray);
     return this;
 }
 
@@ -3403,14 +3848,8 @@ BITSET * __fastcall BITSET::andInto(BITSET * source, DWORD_PTR * changed)
 BITSET * __fastcall BITSET::andIntoLarge(BITSET * source, DWORD_PTR * changed)
 {
     BITSETIMP * bitset = (BITSETIMP*)this;
-    DWORD_PTR * thisDword = bitset->bitArray;
-    DWORD_PTR * sourceDword = ((BITSETIMP*)source)->bitArray;
-    *changed = 0;
-    do {
-        DWORD_PTR saved = *thisDword;   // save the old bits
-        *thisDword &= *(sourceDword++); // compute the new bits
-        *changed |= (saved & ~*(thisDword++));    // extinguished bits are those in old which are not in new
-    } while (thisDword != bitset->arrayEnd);
+    // extinguished bits are those in old which are not in new
+    *changed = AndWords(bitset->bitArray, ((BITSETIMP*)source)->bitArray, bitset->arrayEnd - bitset->bitArray);
     return this;
 }
 
@@ -3578,8 +4017,7 @@ BITSET * __fastcall BITSET::setIntoLarge(BITSET * source, NorlsAllocator * alloc
     BITSETIMP * bitset = (BITSETIMP*)source;
     size_t size = bitset->arrayEnd - bitset->bitArray; // this is size in DWORD_PTRS
     BITSETIMP * rval = (BITSETIMP*) this;
-    *changed = memcmp(bitset->bitArray, rval->bitArray, size * sizeof(DWORD_PTR));
-    memcpy(rval->bitArray, bitset->bitArray , size * sizeof(DWORD_PTR));
+    *changed = CopyWords(rval->bitArray, bitset->bitArray, size);
     rval->arrayEnd = rval->bitArray + size;
     return (BITSET*) rval;
 }
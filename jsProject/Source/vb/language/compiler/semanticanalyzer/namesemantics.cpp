@@ -706,6 +706,79 @@ void Semantics::DoUnfilteredExtensionMethodLookupInImportedTargets
 }
 
 
+// Appends the classes and namespace rings that DoUnfilteredExtensionMethodLookupInImportedTargets
+// visits for pTargets and pExtraTargets, in the same order. A NULL follows each group so that
+// the grouping, which determines precedence levels, is part of the list.
+static void
+AddExtensionMethodImportTargets
+(
+    ImportedTarget * pTargets,
+    ImportedTarget * pExtraTargets,
+    _Inout_ DynamicArray<void *> & targets
+)
+{
+    TypeExtensionImportsIterator targetIterator(pTargets);
+    TypeExtensionImportsIterator extraTargetIterator(pExtraTargets);
+
+    ChainIterator<BCSYM_Class*> typeIterator(&targetIterator, &extraTargetIterator);
+
+    while (typeIterator.MoveNext())
+    {
+        targets.AddElement(typeIterator.Current());
+    }
+
+    targets.AddElement(NULL);
+
+    ImportedNamespaceRingIterator targetRingIterator(pTargets);
+    ImportedNamespaceRingIterator extraTargetRingIterator(pExtraTargets);
+
+    ChainIterator<BCSYM_NamespaceRing*> ringIterator(&targetRingIterator, &extraTargetRingIterator);
+
+    while (ringIterator.MoveNext())
+    {
+        targets.AddElement(ringIterator.Current());
+    }
+
+    targets.AddElement(NULL);
+}
+
+// Returns the import set for everything pSourceFile imports extension methods from.
+// Files that see the same classes and namespaces through their imports get the same
+// import set, so the entries built for one file's imports are reused by the others.
+// The set is computed once per file and kept until the cache is cleared, which is
+// also what drops the file's own entries when its imports change.
+ExtensionMethodImportSet *
+Semantics::GetExtensionMethodImportSet
+(
+    SourceFile * pSourceFile
+)
+{
+    VSASSERT(CanUseExtensionMethodCache(), "Import sets live in the extension method cache.");
+
+    ExtensionMethodImportSet * pImportSet = NULL;
+
+    if (m_ExtensionMethodLookupCache->LookupSourceFileImportSet(pSourceFile, &pImportSet))
+    {
+        return pImportSet;
+    }
+
+    CompilerProject * pProject = pSourceFile->GetProject();
+    ImportedTarget * pExtraTargets =
+        pSourceFile->ShouldSemanticsUseExtraImportForExtensionMethods() ? pSourceFile->GetExtraTrackedImport() : NULL;
+
+    // Namespace lookups depend on the referencing project, so it is part of the set.
+    DynamicArray<void *> targets;
+    targets.AddElement(pProject);
+
+    AddExtensionMethodImportTargets(pSourceFile->GetUnnamedNamespace()->GetImports(), pExtraTargets, targets);
+    AddExtensionMethodImportTargets(pProject->GetImportedTargets(), pExtraTargets, targets);
+
+    pImportSet = m_ExtensionMethodLookupCache->InternImportSet(targets.Array(), targets.Count());
+    m_ExtensionMethodLookupCache->SetSourceFileImportSet(pSourceFile, pImportSet);
+
+    return pImportSet;
+}
+
 ExtensionMethodLookupCacheEntry *
 Semantics::DoUnfilteredExtensionMethodLookupInSourceFileImports
 (
@@ -714,6 +787,7 @@ Semantics::DoUnfilteredExtensionMethodLookupInSourceFileImports
 )
 {
     ExtensionMethodLookupCacheEntry * pRet = NULL;
+    ExtensionMethodImportSet * pImportSet = NULL;
 
     if (CanUseExtensionMethodCache())
     {
@@ -730,6 +804,36 @@ Semantics::DoUnfilteredExtensionMethodLookupInSourceFileImports
         {
             return pRet;
         }
+
+        // Another file with the same imports may already have done this lookup.
+        pImportSet = GetExtensionMethodImportSet(pSourceFile);
+
+        if
+        (
+            m_ExtensionMethodLookupCache->LookupInCache
+            (
+                pName,
+                ExtensionMethodLookupCacheKeyObject(pImportSet),
+                Usage_InsideObject,
+                &pRet
+            )
+        )
+        {
+            TIMERCOUNT(COUNT_ExtensionMethodImportSetHits, 1);
+
+            // The other file loaded the metadata for these same imports.
+            pSourceFile->SetImportedExtensionMethodMetaDataLoaded(true);
+
+            m_ExtensionMethodLookupCache->AddEntry
+            (
+                pName,
+                ExtensionMethodLookupCacheKeyObject(pSourceFile),
+                Usage_InsideObject,
+                pRet
+            );
+
+            return pRet;
+        }
     }
 
     unsigned long precedenceLevel = 0;
@@ -785,6 +889,14 @@ Semantics::DoUnfilteredExtensionMethodLookupInSourceFileImports
             Usage_InsideObject,
             pRet
         );
+
+        m_ExtensionMethodLookupCache->AddEntry
+        (
+            pName,
+            ExtensionMethodLookupCacheKeyObject(pImportSet),
+            Usage_InsideObject,
+            pRet
+        );
     }
 
     return pRet;
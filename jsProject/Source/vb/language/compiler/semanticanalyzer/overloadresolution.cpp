@@ -398,10 +398,26 @@ Semantics::InsertIfMethodAvailable
     }
 
 
+    if (NewCandidateNode == NULL)
+    {
+        NewCandidateNode =
+            new(ListStorage)
+            OverloadList(
+                NewCandidate,
+                GenericBindingContext,
+                NULL,
+                ExpandNewCandidateParamArray,
+                PrecedenceLevel);
+
+        NewCandidateNode->IsExtensionMethod = CandidateIsExtensionMethod;
+    }
+
     bool InferenceFailedForNewCandidate =
         IsGeneric(NewCandidate) &&
         (GenericBindingContext.IsNull() || GenericBindingContext.IsPartialBinding() || GenericBindingContext.IsGenericTypeBinding());
 
+    unsigned FirstArgument = (OvrldFlags & OvrldSomeCandidatesAreExtensionMethods) ? 1 : 0;
+
     while (Current)
     {
         bool InferenceFailedForExistingCandidate =
@@ -437,85 +453,38 @@ Semantics::InsertIfMethodAvailable
             return Candidates;
         }
 
-        Parameter *NewCandidateParameter = ViewAsProcedure(NewCandidate)->GetFirstParam();
-        Parameter *ExistingCandidateParameter = ViewAsProcedure(ExistingCandidate)->GetFirstParam();
-        unsigned CurrentArgument  = 0;
+        OverloadSignature *NewCandidateSignature =
+            GetOverloadSignature(NewCandidateNode, FirstArgument, ArgumentCount, ListStorage);
+        OverloadSignature *ExistingCandidateSignature =
+            GetOverloadSignature(Current, FirstArgument, ArgumentCount, ListStorage);
 
-        if (CandidateIsExtensionMethod)
-        {
-            ThrowIfNull(NewCandidateParameter);
-            NewCandidateParameter = NewCandidateParameter->GetNext();
-
-        }
-
-        if (Current->IsExtensionMethod)
-        {
-            ExistingCandidateParameter = ExistingCandidateParameter->GetNext();
-        }
-
-        if (OvrldFlags & (OvrldSomeCandidatesAreExtensionMethods))
-        {
-            ++CurrentArgument;
-        }
-
-        unsigned NewCandidateParamArrayMatch = 0;
-        unsigned ExistingCandidateParamArrayMatch = 0;
-        bool ExistingCandidateHasParamArrayParameter = false;
-        bool NewCandidateHasParamArrayParameter = false;
-
-        for (; CurrentArgument < ArgumentCount; CurrentArgument++)
+        for (unsigned CurrentArgument = FirstArgument; CurrentArgument < ArgumentCount; CurrentArgument++)
         {
             bool BothLose = false;
             bool NewCandidateWins = false;
             bool ExistingCandidateWins = false;
 
-            CompareParameterApplicability(
+            CompareParameterTypeApplicability(
                 NULL,
-                NewCandidateParameter,
+                NewCandidateSignature->ParameterTypes[CurrentArgument - FirstArgument],
                 ViewAsProcedure(NewCandidate),
-                GenericBindingContext,
-                ExpandNewCandidateParamArray,
-                ExistingCandidateParameter,
+                ExistingCandidateSignature->ParameterTypes[CurrentArgument - FirstArgument],
                 ViewAsProcedure(ExistingCandidate),
-                Current->Binding,
-                Current->ParamArrayExpanded,
                 NewCandidateWins,
                 ExistingCandidateWins,
-                BothLose,
-                CandidateIsExtensionMethod,
-                Current->IsExtensionMethod);
+                BothLose);
 
             if (BothLose || NewCandidateWins || ExistingCandidateWins)
             {
                 goto continueloop; // Go to next candidate
             }
-
-            if (NewCandidateParameter->IsParamArray())
-            {
-                NewCandidateHasParamArrayParameter = true;
-            }
-
-            if (ExistingCandidateParameter->IsParamArray())
-            {
-                ExistingCandidateHasParamArrayParameter = true;
-            }
-
-
-            // If a parameter is a param array, there is no next parameter and so advancing
-            // through the parameter list is bad.
-            if (!NewCandidateParameter->IsParamArray() || !ExpandNewCandidateParamArray)
-            {
-                NewCandidateParameter = NewCandidateParameter->GetNext();
-                NewCandidateParamArrayMatch++;
-            }
-
-            if (!ExistingCandidateParameter->IsParamArray() || !Current->ParamArrayExpanded)
-            {
-                ExistingCandidateParameter = ExistingCandidateParameter->GetNext();
-                ExistingCandidateParamArrayMatch++;
-            }
         }
 
+        unsigned NewCandidateParamArrayMatch = NewCandidateSignature->ParamArrayMatch;
+        unsigned ExistingCandidateParamArrayMatch = ExistingCandidateSignature->ParamArrayMatch;
+        bool NewCandidateHasParamArrayParameter = NewCandidateSignature->HasParamArrayParameter;
+        bool ExistingCandidateHasParamArrayParameter = ExistingCandidateSignature->HasParamArrayParameter;
+
         Procedure * NewCandidateProcedure = ViewAsProcedure(NewCandidate);
         Procedure * ExistingCandidateProcedure = ViewAsProcedure(ExistingCandidate);
 
@@ -697,20 +666,6 @@ continueloop:
         Current = Current->Next;
     }
 
-    if (NewCandidateNode == NULL)
-    {
-        NewCandidateNode =
-            new(ListStorage)
-            OverloadList(
-                NewCandidate,
-                GenericBindingContext,
-                NULL,
-                ExpandNewCandidateParamArray,
-                PrecedenceLevel);
-
-        NewCandidateNode->IsExtensionMethod = CandidateIsExtensionMethod;
-    }
-
     NewCandidateNode->Next = Candidates;
     CandidateCount++;
 
@@ -719,6 +674,82 @@ continueloop:
     return NewCandidateNode;
 }
 
+// Returns the types Candidate's parameters are compared by for the arguments
+// [FirstArgument, ArgumentCount), building them if they haven't been built for
+// these arguments and the candidate's current binding.
+//
+OverloadSignature *
+Semantics::GetOverloadSignature
+(
+    _Inout_ OverloadList *Candidate,
+    unsigned FirstArgument,
+    unsigned ArgumentCount,
+    _Inout_ NorlsAllocator &ListStorage
+)
+{
+    OverloadSignature *Signature = Candidate->Signature;
+
+    if (Signature &&
+        Signature->FirstArgument == FirstArgument &&
+        Signature->ArgumentCount == ArgumentCount &&
+        Signature->Binding == Candidate->Binding)
+    {
+        return Signature;
+    }
+
+    if (Signature == NULL)
+    {
+        Signature = new(ListStorage) OverloadSignature();
+        Candidate->Signature = Signature;
+    }
+
+    Signature->Binding = Candidate->Binding;
+    Signature->FirstArgument = FirstArgument;
+    Signature->ArgumentCount = ArgumentCount;
+    Signature->ParamArrayMatch = 0;
+    Signature->HasParamArrayParameter = false;
+    Signature->ParameterTypes =
+        ArgumentCount > FirstArgument ?
+            (Type **)ListStorage.Alloc(VBMath::Multiply(ArgumentCount - FirstArgument, sizeof(Type *))) :
+            NULL;
+
+    Parameter *CurrentParameter = ViewAsProcedure(Candidate->Candidate)->GetFirstParam();
+
+    if (Candidate->IsExtensionMethod)
+    {
+        ThrowIfNull(CurrentParameter);
+        CurrentParameter = CurrentParameter->GetNext();
+    }
+
+    for (unsigned CurrentArgument = FirstArgument; CurrentArgument < ArgumentCount; CurrentArgument++)
+    {
+        // Candidates have been filtered by argument count, so there is a
+        // parameter for every argument.
+        ThrowIfNull(CurrentParameter);
+
+        Signature->ParameterTypes[CurrentArgument - FirstArgument] =
+            ReplaceGenericParametersWithArguments(
+                GetParamTypeToCompare(CurrentParameter, Candidate->ParamArrayExpanded),
+                Candidate->Binding,
+                m_SymbolCreator);
+
+        if (CurrentParameter->IsParamArray())
+        {
+            Signature->HasParamArrayParameter = true;
+        }
+
+        // If a parameter is a param array, there is no next parameter and so advancing
+        // through the parameter list is bad.
+        if (!CurrentParameter->IsParamArray() || !Candidate->ParamArrayExpanded)
+        {
+            CurrentParameter = CurrentParameter->GetNext();
+            Signature->ParamArrayMatch++;
+        }
+    }
+
+    return Signature;
+}
+
 void
 Semantics::CompareParamarraySpecificity
 (
@@ -1114,9 +1145,22 @@ Semantics::CollectOverloadCandidates
     {
         GenericBinding *CandidateGenericBinding = NULL;
 
+        // The parameter counts of the overloads, if the chain can be cached.
+        OverloadArityCache::Arity *Arities = NULL;
+        unsigned ArityCount = 0;
+
+        if (m_PermitDeclarationCaching &&
+            m_OverloadArityCache &&
+            !OverloadedProcedure->GetContainer()->IsTransient())
+        {
+            Arities = m_OverloadArityCache->GetArities(OverloadedProcedure, &ArityCount);
+        }
+
+        unsigned OverloadIndex = 0;
+
         for (Declaration *NextProcedure = OverloadedProcedure;
              NextProcedure;
-             NextProcedure = NextProcedure->GetNextOverload())
+             NextProcedure = NextProcedure->GetNextOverload(), OverloadIndex++)
         {
             // Amazingly, non-procedures can land here if a class defines both fields
             // and methods with the same name. (This is impossible in VB, but apparently
@@ -1180,8 +1224,21 @@ Semantics::CollectOverloadCandidates
             // If type arguments have been supplied, ---- out procedures that don't have an
             // appropriate number of type parameters.
 
+            OverloadArityCache::Arity *CachedArity =
+                OverloadIndex < ArityCount ?
+                    &Arities[OverloadIndex] :
+                    NULL;
+
+            VSASSERT(!Arities || (CachedArity && CachedArity->IsProcedure), "Overload chain changed since its arities were cached.");
+
+            if (CachedArity && !CachedArity->IsProcedure)
+            {
+                CachedArity = NULL;
+            }
+
             if (TypeArgumentCount > 0 &&
-                TypeArgumentCount != NextProcedure->GetGenericParamCount())
+                TypeArgumentCount !=
+                    (CachedArity ? CachedArity->GenericParamCount : NextProcedure->GetGenericParamCount()))
             {
                 RejectedForTypeArgumentCount++;
                 continue;
@@ -1193,7 +1250,16 @@ Semantics::CollectOverloadCandidates
             unsigned MaximumParameterCount = 0;
             bool HasParamArray = false;
 
-            NonAliasProcedure->GetAllParameterCounts(RequiredParameterCount, MaximumParameterCount, HasParamArray);
+            if (CachedArity)
+            {
+                RequiredParameterCount = CachedArity->RequiredParameterCount;
+                MaximumParameterCount = CachedArity->MaximumParameterCount;
+                HasParamArray = CachedArity->HasParamArray;
+            }
+            else
+            {
+                NonAliasProcedure->GetAllParameterCounts(RequiredParameterCount, MaximumParameterCount, HasParamArray);
+            }
 
             unsigned ArgumentCountToUseForComparison = (OvrldFlags & OvrldSomeCandidatesAreExtensionMethods) ? ArgumentCount  - 1: ArgumentCount;
 
@@ -2838,6 +2838,16 @@ Semantics::InitializeInterpretationState
             {
                 m_LiftedOperatorCache = m_Project->GetLiftedOperatorCache();
             }
+
+            if (!m_ConversionCache)
+            {
+                m_ConversionCache = m_Project->GetConversionCache();
+            }
+
+            if (!m_OverloadArityCache)
+            {
+                m_OverloadArityCache = m_Project->GetOverloadArityCache();
+            }
         }
 
         if (GetCompilerHost() && !m_MergedNamespaceCache)
@@ -3582,6 +3592,7 @@ Semantics::Semantics
     m_NamedContextForAppliedAttribute(NULL),
     m_DefAsgCount(0),
     m_DefAsgAllocator(*TreeStorage),
+    m_DefAsgReEvalHeap(NULL),
     m_AltErrTablesForConstructor(NULL),
     m_fIncludeBadExpressions(fIncludeBadExpressions),
     m_pReceiverType(NULL),
@@ -3602,6 +3613,8 @@ Semantics::Semantics
     m_statementGroupId(1),
     m_ExtensionMethodLookupCache(NULL),
     m_LiftedOperatorCache(NULL),
+    m_ConversionCache(NULL),
+    m_OverloadArityCache(NULL),
     m_InterpretingMethodBody(false),
     m_XmlNameVars(NULL),
     m_AnonymousTypeBindingTable(NULL),
@@ -3663,6 +3676,8 @@ Semantics::Semantics
             m_LookupCache = m_SourceFile->GetProject()->GetLookupCache();
             m_ExtensionMethodLookupCache = m_SourceFile->GetProject()->GetExtensionMethodLookupCache();
             m_LiftedOperatorCache = m_SourceFile->GetProject()->GetLiftedOperatorCache();
+            m_ConversionCache = m_SourceFile->GetProject()->GetConversionCache();
+            m_OverloadArityCache = m_SourceFile->GetProject()->GetOverloadArityCache();
         }
 
         if (GetCompilerHost())
@@ -3725,6 +3740,8 @@ Semantics::SetIDECompilationCaches(CompilationCaches *pCompilationCaches)
         m_LookupCache = pCompilationCaches->GetLookupCache();
         m_ExtensionMethodLookupCache = pCompilationCaches->GetExtensionMethodLookupCache();
         m_LiftedOperatorCache = pCompilationCaches->GetLiftedOperatorCache();
+        m_ConversionCache = pCompilationCaches->GetConversionCache();
+        m_OverloadArityCache = pCompilationCaches->GetOverloadArityCache();
         m_MergedNamespaceCache = pCompilationCaches->GetMergedNamespaceCache();
 
         m_CompilationCaches = pCompilationCaches;
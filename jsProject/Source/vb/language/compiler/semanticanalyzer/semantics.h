@@ -343,6 +343,7 @@ const unsigned short NoResume = 0xfffe;
 const unsigned short ForLoopVariableCount = 0x2;
 
 struct OverloadList;
+struct OverloadSignature;
 class TypeSet;
 class Semantics;
 
@@ -712,6 +713,7 @@ class ClosureRoot;
 class OptimizedClosure;
 class ClosureGotoIterator;
 class ParserHelper;
+class DefAsgReEvalHeap;
 
 typedef HashTable<0x100> FromItemsHashTable;
 
@@ -1668,6 +1670,43 @@ public:
         unsigned int ClosureDepth
     );
 
+    static bool
+    IsDefAsgWorklistOrder
+    (
+    );
+
+    bool
+    DefAsgSolve
+    (
+        ILTree::ProcedureBlock *BoundBody,
+        bool IncludeLocals,
+        bool IncludeReturns,
+        bool ReportInitialRun
+    );
+
+    DefAsgReEvalStmt *
+    DefAsgTakeNextReEvalStmt
+    (
+    );
+
+    void
+    DefAsgAddReEvalStmt
+    (
+        ILTree::PILNode stmt,
+        unsigned int ClosureDepth
+    );
+
+    void
+    DefAsgRemoveReEvalStmt
+    (
+        ILTree::PILNode stmt
+    );
+
+    bool
+    DefAsgHasReEvalStmts
+    (
+    );
+
     ILTree::TryBlock*
     DefAsgUpdateTryGroupOutBitSet
     (
@@ -2240,6 +2279,12 @@ protected:
         SourceFile * pSourceFile
     );
 
+    ExtensionMethodImportSet *
+    GetExtensionMethodImportSet
+    (
+        SourceFile * pSourceFile
+    );
+
 
     ExtensionMethodLookupCacheEntry *
     DoUnfilteredExtensionMethodLookupInClassImport
@@ -6795,6 +6840,15 @@ protected:
         _Inout_opt_ AsyncSubAmbiguityFlagCollection **ppAsyncSubArgumentListAmbiguity = NULL
     );
 
+    OverloadSignature *
+    GetOverloadSignature
+    (
+        _Inout_ OverloadList *Candidate,
+        unsigned FirstArgument,
+        unsigned ArgumentCount,
+        _Inout_ NorlsAllocator &ListStorage
+    );
+
     void
     CompareParamarraySpecificity
     (
@@ -8446,7 +8500,22 @@ protected:
         DelegateRelaxationLevel *pConversionRelaxationLevel = NULL,  // [out] If converting a VB$AnonymousDelegate to a delegate type, how did it relax?
         bool IgnoreOperatorMethod = false
     );
-    
+    // ClassifyConversion, without looking in or adding to m_ConversionCache.
+    ConversionClass
+    ClassifyUncachedConversion
+    (
+        Type *TargetType,
+        Type *SourceType,
+        Procedure *&OperatorMethod,
+        GenericBinding *&OperatorMethodGenericContext,
+        bool &OperatorMethodIsLifted,
+        bool considerConversionsOnNullableBool,
+        bool * pConversionRequiresUnliftedAccessToNullableValue,
+        bool *pConversionIsNarrowingDueToAmbiguity,
+        DelegateRelaxationLevel *pConversionRelaxationLevel,
+        bool IgnoreOperatorMethod
+    );
+
     ConversionClass
     ClassifyPredefinedCLRConversion
     (
@@ -10786,6 +10855,8 @@ protected:
     LookupTree *m_LookupCache;
     ExtensionMethodNameLookupCache * m_ExtensionMethodLookupCache;
     LiftedUserDefinedOperatorCache * m_LiftedOperatorCache;
+    ConversionClassificationCache * m_ConversionCache;
+    OverloadArityCache * m_OverloadArityCache;
     NamespaceRingTree *m_MergedNamespaceCache;
     bool m_DoNotMergeNamespaceCaches;
     CompilationCaches *m_CompilationCaches;
@@ -10798,6 +10869,9 @@ protected:
     BITSET * m_DefAsgTempBitset;    // work set for temporary use
     BITSET * m_DefAsgErrorDisplayedBitset;
     DefAsgReEvalStmtList m_DefAsgReEvalStmtList;
+    // The pending re-evaluations, instead of m_DefAsgReEvalStmtList, when they
+    // are taken in worklist order (see IsDefAsgWorklistOrder).
+    DefAsgReEvalHeap * m_DefAsgReEvalHeap;
     bool    m_DefAsgIsReachableCode;
     bool    m_DefAsgOnErrorSeen;
 #if DEBUG
@@ -12458,6 +12532,29 @@ IsCircularTypeReference
     Type *MemberType
 );
 
+// The types that InsertIfMethodAvailable compares a candidate's parameters by,
+// one per argument, with the candidate's binding substituted.  A candidate is
+// compared against every candidate collected after it, so these are worked out
+// once, for the arguments and binding they were built for.
+struct OverloadSignature
+{
+    Type **ParameterTypes;          // [ArgumentCount - FirstArgument]
+    GenericBindingInfo Binding;
+    unsigned FirstArgument;
+    unsigned ArgumentCount;
+    unsigned ParamArrayMatch;       // arguments not matched to an expanded paramarray
+    bool HasParamArrayParameter;
+
+    OverloadSignature() :
+        ParameterTypes(NULL),
+        FirstArgument(0),
+        ArgumentCount(0),
+        ParamArrayMatch(0),
+        HasParamArrayParameter(false)
+    {
+    }
+};
+
 struct OverloadList
 {
     Declaration *Candidate;
@@ -12489,6 +12586,8 @@ struct OverloadList
     //do not use it otherwise.
     bool RequiresInstanceMethodBinding;
     bool UsedDefaultForAnOptionalParameter;
+    // Built by GetOverloadSignature the first time the candidate is compared.
+    OverloadSignature *Signature;
 
     OverloadList
     (
@@ -12516,7 +12615,8 @@ struct OverloadList
         RequiresUnwrappingNullable(false),
         IsExtensionMethod(false),
         RequiresInstanceMethodBinding(true),
-        UsedDefaultForAnOptionalParameter(false)
+        UsedDefaultForAnOptionalParameter(false),
+        Signature(NULL)
     {
     }
 };
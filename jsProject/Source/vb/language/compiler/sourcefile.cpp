@@ -55,17 +55,44 @@ bool SourceFile::_StepToBuiltSymbols()
 
     // Get the trees.
 
-    IfFailThrow(GetDeclTrees(&nraDeclTrees,
-        &m_nraSymbols,
-        perrorTable,
-        &pcontainer,
-        GetLineMarkerTable(),
-        &ptree));
+#if !IDE
+    AutoPtr<NorlsAllocator> spnraPreparsedDeclTrees;
+
+    if (m_fPreparsedDeclTrees)
+    {
+        // Already parsed by CompilerProject::ParseDeclTreesInParallel.
+        m_fPreparsedDeclTrees = false;
+        spnraPreparsedDeclTrees.Attach(m_pnraPreparsedDeclTrees);
+        m_pnraPreparsedDeclTrees = NULL;
+
+        IfFailThrow(m_hrPreparsedDeclTrees);
+
+        pcontainer = m_pPreparsedConditionalConstants;
+        ptree = m_pPreparsedDeclTrees;
+    }
+    else
+#endif !IDE
+    {
+#if !IDE
+        m_daExternalChecksumDirectives.Reset();
+#endif !IDE
+
+        IfFailThrow(GetDeclTrees(&nraDeclTrees,
+            &m_nraSymbols,
+            perrorTable,
+            &pcontainer,
+            GetLineMarkerTable(),
+            &ptree));
+    }
 
 #if IDE 
     m_HasParseErrors = perrorTable->HasErrorsThroughStep(CS_NoStep);
 #endif
 
+#if !IDE
+    AddExternalChecksumsToProject(perrorTable);
+#endif !IDE
+
     // Create the symbols from the trees.
     Declared::MakeDeclared(
         GetCompilerHost(),
@@ -76,6 +103,22 @@ bool SourceFile::_StepToBuiltSymbols()
         perrorTable,
         &m_SymbolList);
 
+    // Nothing the symbols hold points into the decl trees, so give their pages
+    // back now instead of when we return.  The hash table built below and the
+    // next file's symbols get allocated from them.
+    ptree = NULL;
+
+#if !IDE
+    if (spnraPreparsedDeclTrees)
+    {
+        TIMERCOUNT(COUNT_DeclTreeBytesCommitted, spnraPreparsedDeclTrees->CalcCommittedSize());
+        spnraPreparsedDeclTrees.Destroy();
+    }
+#endif !IDE
+
+    TIMERCOUNT(COUNT_DeclTreeBytesCommitted, nraDeclTrees.CalcCommittedSize());
+    nraDeclTrees.FreeHeap();
+
     // If we don't have any parse trees (e.g. the VB file is in the .vbproj file but it doesn't exist),
     // MakeDeclared will do nothing, but we still need to create an empty unnamednamespace for this file.
     // VS199349
@@ -545,6 +588,14 @@ SourceFile::SourceFile
 
 #endif IDE
 
+#if !IDE
+    m_fPreparsedDeclTrees = false;
+    m_hrPreparsedDeclTrees = NOERROR;
+    m_pnraPreparsedDeclTrees = NULL;
+    m_pPreparsedDeclTrees = NULL;
+    m_pPreparsedConditionalConstants = NULL;
+#endif !IDE
+
     ClearingBindingStatus();
 
  }
@@ -638,6 +689,16 @@ void SourceFile::Invalidate(bool SkipDemoteNodesCheck /* = true */)
 
 #endif IDE
 
+#if !IDE
+    if (m_pnraPreparsedDeclTrees)
+    {
+        delete m_pnraPreparsedDeclTrees;
+        m_pnraPreparsedDeclTrees = NULL;
+    }
+    m_fPreparsedDeclTrees = false;
+    m_daExternalChecksumDirectives.Destroy();
+#endif !IDE
+
     if(m_pDaUnprocessedFriends)
     {
         delete m_pDaUnprocessedFriends;
@@ -1853,7 +1914,7 @@ public:
         if (pRef)
         {
             // copy in case the original is deleted.
-            TextFileCacheRef* pFileCacheRef = new (zeromemory) TextFileCacheRef(pRef->GetOffset(), pRef->GetSize(), pRef->GetTimestamp(), pRef->IsDetectUTF8WithoutSig());
+            TextFileCacheRef* pFileCacheRef = new (zeromemory) TextFileCacheRef(pRef->GetSection(), pRef->GetOffset(), pRef->GetSize(), pRef->GetTimestamp(), pRef->IsDetectUTF8WithoutSig());
             pFileCacheRef->SetUnicode(true);
 
             CComPtr<IVsTaskSchedulerService> spTaskSchedulerService = GetCompilerPackage()->GetTaskSchedulerService();
@@ -1947,24 +2008,114 @@ SourceFile::ParseCodeBlock
         IfFailGo(text.Init(this));
         ptext = &text;
     }
-    IfFailGo(::ParseCodeBlock(m_pCompiler,
+
+    MethodBodyParseKey key;
+    MethodBodyParseText keyText;
+    bool fAdmit = false;
+
+    if (GetMethodBodyParseKey(ptext, pCodeBlock, pProcBlock, MethodBodyKind, methodDeclKind, &key, &keyText))
+    {
+        *pptree = m_MethodBodyParseCache.Lookup(key, keyText, &fAdmit);
+    }
+
+    if (!*pptree && fAdmit && perrortable)
+    {
+        // Parse the body into an allocator of its own and keep the tree if parsing
+        // it didn't report anything.  If it did, the body is parsed again below so
+        // that the tree ends up in pnra; this only happens once per body.
+        NorlsAllocator *pnraTree = new NorlsAllocator(NORLSLOC);
+        ErrorTable errors(*perrortable);
+
+        hr = ::ParseCodeBlock(m_pCompiler,
                               ptext,
                               this,
-                              pnra,
-                              perrortable,
+                              pnraTree,
+                              &errors,
                               pConditionalCompilationConstants,
                               pCodeBlock,
                               pProcBlock,
                               MethodBodyKind,
-                              pptree, 
+                              pptree,
                               methodDeclKind,
-                              false));
+                              false);
+
+        if (SUCCEEDED(hr) && *pptree && !errors.HasErrors() && !errors.HasWarnings())
+        {
+            *pptree = m_MethodBodyParseCache.Add(key, keyText, pnraTree, *pptree);
+        }
+        else
+        {
+            m_MethodBodyParseCache.Add(key, keyText, NULL, NULL);
+            delete pnraTree;
+            *pptree = NULL;
+            hr = NOERROR;
+        }
+    }
+
+    // Not cached, or not cacheable after all.
+    if (!*pptree)
+    {
+        IfFailGo(::ParseCodeBlock(m_pCompiler,
+                                  ptext,
+                                  this,
+                                  pnra,
+                                  perrortable,
+                                  pConditionalCompilationConstants,
+                                  pCodeBlock,
+                                  pProcBlock,
+                                  MethodBodyKind,
+                                  pptree, 
+                                  methodDeclKind,
+                                  false));
+    }
 
     VB_EXIT_NORETURN();
 Error:
     RRETURN(hr);
 }
 
+//============================================================================
+// Build the key under which the parse tree of a code block is cached.
+// Returns false if the block can't be cached.
+//============================================================================
+
+bool SourceFile::GetMethodBodyParseKey
+(
+    Text *ptext,
+    const CodeBlockLocation *pCodeBlock,
+    const CodeBlockLocation *pProcBlock,
+    ParseTree::Statement::Opcodes MethodBodyKind,
+    MethodDeclKind methodDeclKind,
+    _Out_ MethodBodyParseKey *pKey,
+    _Out_ MethodBodyParseText *pText
+)
+{
+    memset(pKey, 0, sizeof(*pKey));
+
+    const WCHAR *wszBody = NULL;
+    size_t cchBody = 0;
+    const WCHAR *wszProc = NULL;
+    size_t cchProc = 0;
+
+    ptext->GetTextOfRange(pCodeBlock->m_oBegin, pCodeBlock->m_oEnd, &wszBody, &cchBody);
+    pKey->m_lBodyLine = pCodeBlock->m_lBegLine;
+    pKey->m_lBodyColumn = pCodeBlock->m_lBegColumn;
+
+    if (pProcBlock)
+    {
+        ptext->GetTextOfRange(pProcBlock->m_oBegin, pProcBlock->m_oEnd, &wszProc, &cchProc);
+        pKey->m_lProcLine = pProcBlock->m_lBegLine;
+        pKey->m_lProcColumn = pProcBlock->m_lBegColumn;
+    }
+
+    pKey->m_MethodBodyKind = MethodBodyKind;
+    pKey->m_MethodDeclKind = methodDeclKind;
+    pKey->m_LanguageVersion = m_pProject->GetCompilingLanguageVersion();
+    pKey->m_fXMLDocOn = m_pProject->IsXMLDocCommentsOn();
+
+    return MethodBodyParseCache::HashText(wszBody, cchBody, wszProc, cchProc, pKey, pText);
+}
+
 HRESULT SourceFile::GetDeclTrees
 (
     NorlsAllocator *pTreeAllocator, // [in] allocator to hold the declaration trees
@@ -2000,6 +2151,109 @@ Error:
     RRETURN( hr );
 }
 
+#if !IDE
+
+//============================================================================
+// Parse the declaration trees of this file so that _StepToBuiltSymbols
+// only has to build the symbols.  This touches nothing but the file itself
+// and the StringPool, which is locked, so different files may be preparsed
+// on different threads at the same time.
+//============================================================================
+
+void SourceFile::PreparseDeclTrees()
+{
+    VSASSERT(m_cs == CS_NoState, "Bad state.");
+    VSASSERT(!m_fPreparsedDeclTrees, "Already preparsed.");
+
+    m_fPreparsedDeclTrees = true;
+    m_pPreparsedDeclTrees = NULL;
+    m_pPreparsedConditionalConstants = NULL;
+    m_daExternalChecksumDirectives.Reset();
+
+    VB_ENTRY();
+    m_pnraPreparsedDeclTrees = new NorlsAllocator(NORLSLOC);
+
+    hr = GetDeclTrees(m_pnraPreparsedDeclTrees,
+        &m_nraSymbols,
+        GetCurrentErrorTable(),
+        &m_pPreparsedConditionalConstants,
+        GetLineMarkerTable(),
+        &m_pPreparsedDeclTrees);
+
+    VB_EXIT_NORETURN();
+
+    m_hrPreparsedDeclTrees = hr;
+}
+
+void SourceFile::AddExternalChecksumDirective
+(
+    _In_z_ const WCHAR *FileName,
+    _In_z_ const WCHAR *Guid,
+    _In_z_ const WCHAR *ChecksumVal,
+    const Location &FileNameSpan,
+    const Location &GuidSpan,
+    const Location &ChecksumValSpan
+)
+{
+    // The strings live in the parse trees, which may be gone by the time
+    // _StepToBuiltSymbols looks at them.
+    ExternalChecksumDirective &directive = m_daExternalChecksumDirectives.Add();
+    directive.FileName = m_pCompiler->AddString(FileName);
+    directive.Guid = m_pCompiler->AddString(Guid);
+    directive.ChecksumVal = m_pCompiler->AddString(ChecksumVal);
+    directive.FileNameSpan = FileNameSpan;
+    directive.GuidSpan = GuidSpan;
+    directive.ChecksumValSpan = ChecksumValSpan;
+}
+
+//============================================================================
+// Add the #ExternalChecksum directives of the last declaration parse to the
+// project.  Only called on the compile thread, so the project's list and the
+// file blamed for conflicting directives do not depend on parse timing.
+//============================================================================
+
+void SourceFile::AddExternalChecksumsToProject(ErrorTable *pErrorTable)
+{
+    ULONG cDirectives = m_daExternalChecksumDirectives.Count();
+    ExternalChecksumDirective *rgDirectives = m_daExternalChecksumDirectives.Array();
+
+    for (ULONG i = 0; i < cDirectives; i++)
+    {
+        ExternalChecksumDirective &directive = rgDirectives[i];
+        ERRID error;
+
+        if (!GetProject()->AddExternalChecksum(
+                directive.FileName,
+                directive.Guid,
+                directive.ChecksumVal,
+                error))
+        {
+            Location *wrnSpan;
+            switch (error)
+            {
+            case WRNID_BadChecksumValExtChecksum:
+                wrnSpan = &directive.ChecksumValSpan;
+                break;
+            case WRNID_MultipleDeclFileExtChecksum:
+                wrnSpan = &directive.FileNameSpan;
+                break;
+            case WRNID_BadGUIDFormatExtChecksum:
+                wrnSpan = &directive.GuidSpan;
+                break;
+            default:
+                VSFAIL("unexpected error in external checksum");
+                wrnSpan = &directive.FileNameSpan;
+            }
+
+            pErrorTable->CreateError(error, wrnSpan);
+        }
+    }
+
+    m_daExternalChecksumDirectives.Reset();
+}
+
+#endif !IDE
+
 //============================================================================
 // Create the parse trees for the body of this method.
 //============================================================================
@@ -2172,7 +2426,8 @@ HRESULT SourceFile::GetBoundMethodBodyTrees
     ILTree::ILNode **pptree,
     ParseTree::MethodBodyStatement **ppUnboundTree,
     AlternateErrorTableGetter AltErrTablesForConstructor,
-    DynamicArray<BCSYM_Variable *> *pENCMembersToRefresh
+    DynamicArray<BCSYM_Variable *> *pENCMembersToRefresh,
+    ParseTree::MethodBodyStatement *pPreparsedUnboundTree
 )
 {
     bool MergeAnonymousTypes = dwFlags & gmbMergeAnonymousTypes;
@@ -2231,7 +2486,14 @@ HRESULT SourceFile::GetBoundMethodBodyTrees
     // Get the parse trees for this method body.
     //
 
-    IfFailGo(GetUnboundMethodBodyTrees(pproc, pnra, perrortable, ptext, &pUnbound));
+    if (pPreparsedUnboundTree)
+    {
+        pUnbound = pPreparsedUnboundTree;
+    }
+    else
+    {
+        IfFailGo(GetUnboundMethodBodyTrees(pproc, pnra, perrortable, ptext, &pUnbound));
+    }
 
     // No tree will be returned if the file cannot be loaded.
     if (pUnbound)
@@ -3071,6 +3333,7 @@ void SourceFile::_DemoteToNoState()
         SetHasFileLoadError(false);
 
         m_nraSymbols.FreeHeap();
+        m_MethodBodyParseCache.Clear();
 
         m_SymbolList.Clear();
 
@@ -219,6 +219,11 @@ protected:
     // Methods that move this file up states.
     virtual bool _StepToBuiltSymbols();
     virtual bool _StepToBoundSymbols();
+#if !IDE
+    // Parse the declaration trees for _StepToBuiltSymbols ahead of time.
+    // May be called on any thread; see CompilerProject::ParseDeclTreesInParallel.
+    void PreparseDeclTrees();
+#endif
     virtual bool _StepToCheckCLSCompliance();
     virtual bool _StepToEmitTypes();
     virtual bool _StepToEmitTypeMembers();
@@ -279,6 +284,18 @@ protected:
 
 public:
 
+#if !IDE
+    // Records an #ExternalChecksum directive seen by the declaration parser.
+    // It is handed to the project by _StepToBuiltSymbols.
+    void AddExternalChecksumDirective(
+        _In_z_ const WCHAR *FileName,
+        _In_z_ const WCHAR *Guid,
+        _In_z_ const WCHAR *ChecksumVal,
+        const Location &FileNameSpan,
+        const Location &GuidSpan,
+        const Location &ChecksumValSpan);
+#endif !IDE
+
     void SetFileContainsAssemblyKeyFileAttr(
         bool fContains,
         _In_opt_z_ STRING * pstrKeyFileName);
@@ -345,6 +362,15 @@ public:
         ParseTree::MethodBodyStatement ** pptree,
         MethodDeclKind methodDeclKind);
 
+    bool GetMethodBodyParseKey(
+        Text * ptext,
+        const CodeBlockLocation * pCodeBlock,
+        const CodeBlockLocation * pProcBlock,
+        ParseTree::Statement::Opcodes MethodBodyKind,
+        MethodDeclKind methodDeclKind,
+        _Out_ MethodBodyParseKey * pKey,
+        _Out_ MethodBodyParseText * pText);
+
     //  Get the Decl Trees for this file.
     HRESULT GetDeclTrees(
         NorlsAllocator * pnra,
@@ -376,7 +402,8 @@ public:
         ILTree::ILNode ** pptree,
         ParseTree::MethodBodyStatement ** ppUnboundTree = NULL,
         AlternateErrorTableGetter AltErrTablesForConstructor = NULL,
-        DynamicArray<BCSYM_Variable *> * pENCMembersToRefresh = NULL);
+        DynamicArray<BCSYM_Variable *> * pENCMembersToRefresh = NULL,
+        ParseTree::MethodBodyStatement * pPreparsedUnboundTree = NULL);    // parse trees of the body, if already built
 
     HRESULT GetBoundLambdaBodyTrees
     (
@@ -739,6 +766,33 @@ private:
     unsigned m_NumMappedEntries; // Number of mapped entries we will have in the mapping table
 #endif
 
+#if !IDE // The results of PreparseDeclTrees, consumed by _StepToBuiltSymbols
+    bool m_fPreparsedDeclTrees;
+    HRESULT m_hrPreparsedDeclTrees;
+    NorlsAllocator * m_pnraPreparsedDeclTrees; // Owns m_pPreparsedDeclTrees
+    ParseTree::FileBlockStatement * m_pPreparsedDeclTrees;
+    BCSYM_Container * m_pPreparsedConditionalConstants;
+
+    // The #ExternalChecksum directives of the last declaration parse, in source
+    // order.  Parsing may happen on any thread, so they are only added to the
+    // project by _StepToBuiltSymbols, one file at a time and in file order.
+    struct ExternalChecksumDirective
+    {
+        STRING *FileName;
+        STRING *Guid;
+        STRING *ChecksumVal;
+        Location FileNameSpan;
+        Location GuidSpan;
+        Location ChecksumValSpan;
+    };
+    DynamicArray<ExternalChecksumDirective> m_daExternalChecksumDirectives;
+
+    void AddExternalChecksumsToProject(ErrorTable *pErrorTable);
+#endif
+
+    // Trees of the method bodies that were asked for more than once.
+    MethodBodyParseCache m_MethodBodyParseCache;
+
 #if IDE 
 
     // The Line Marker Table.
@@ -15,9 +15,15 @@
 #define BaseStrInfoHashTableSize  4096
 
 // Maximum size for the hash tables to grow to.  Also a power of 2.
-// Must be >= the base hash table sizes above
-#define MaxSpellingHashTableSize 32768
-#define MaxStrInfoHashTableSize  32768
+// Must be >= the base hash table sizes above.
+//
+// When a table grows, each entry's new bucket is rebuilt from the low 10 bits
+// of its old bucket and the 16 significant hash bits kept in the entry
+// (m_ulSysHash / m_ulSpellingHash), so 2^26 buckets is as far as the stored
+// hash can spread entries.  That is effectively unbounded: past a few hundred
+// thousand names the old 32K limit left chains well beyond IdealBucketSize.
+#define MaxSpellingHashTableSize (1024 << 16)
+#define MaxStrInfoHashTableSize  (1024 << 16)
 
 // Allowed average bucket size before growing the tables,
 // preferably a power of 2.
@@ -583,7 +589,7 @@ SAFEARRAY * StringPool::GetStringPoolData()
     WCHAR szBuffer[TEMPBUFSIZE];
     const WCHAR* szFmt =  L"%c,%6d,%08x,%08x,%7d,%4d,%3d,";
 
-    CompilerIdeLock lock(m_CriticalSection);
+    PoolExclusiveLock lock(m_TableLock);
 
     for (iBucket = 0; iBucket < m_ulSpellingHashTableSize; iBucket++)
     {
@@ -740,6 +746,123 @@ inline void dmemcpy
 
 //#pragma optimize("atw", default)
 
+//============================================================================
+// CRC32C (Castagnoli) hash engine used by ComputeHashValue and
+// ComputeStringHashValue.
+//
+// On processors with SSE4.2 the CRC32 instruction computes the checksum of
+// four bytes per step.  Elsewhere the table below computes the same value a
+// byte at a time, so hash values depend only on the input, never on the
+// processor that happens to run the compiler.
+//============================================================================
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define STRINGPOOL_HARDWARE_CRC32C 1
+#include <intrin.h>
+#include <nmmintrin.h>
+#endif
+
+static const unsigned long g_rgulCrc32cTable[256] =
+{
+    0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C,
+    0x26A1E7E8, 0xD4CA64EB, 0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
+    0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24, 0x105EC76F, 0xE235446C,
+    0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+    0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC,
+    0xBC267848, 0x4E4DFB4B, 0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
+    0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35, 0xAA64D611, 0x580F5512,
+    0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+    0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD,
+    0x1642AE59, 0xE4292D5A, 0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
+    0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595, 0x417B1DBC, 0xB3109EBF,
+    0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+    0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F,
+    0xED03A29B, 0x1F682198, 0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
+    0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38, 0xDBFC821C, 0x2997011F,
+    0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+    0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E,
+    0x4767748A, 0xB50CF789, 0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
+    0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46, 0x7198540D, 0x83F3D70E,
+    0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+    0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE,
+    0xDDE0EB2A, 0x2F8B6829, 0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
+    0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93, 0x082F63B7, 0xFA44E0B4,
+    0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+    0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B,
+    0xB4091BFF, 0x466298FC, 0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
+    0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033, 0xA24BB5A6, 0x502036A5,
+    0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+    0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975,
+    0x0E330A81, 0xFC588982, 0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
+    0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622, 0x38CC2A06, 0xCAA7A905,
+    0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+    0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8,
+    0xE52CC12C, 0x1747422F, 0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
+    0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0, 0xD3D3E1AB, 0x21B862A8,
+    0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+    0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78,
+    0x7FAB5E8C, 0x8DC0DD8F, 0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
+    0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1, 0x69E9F0D5, 0x9B8273D6,
+    0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+    0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69,
+    0xD5CF889D, 0x27A40B9E, 0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
+    0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351
+};
+
+#if STRINGPOOL_HARDWARE_CRC32C
+
+static bool IsHardwareCrc32cAvailable()
+{
+    int rgCpuInfo[4];
+
+    // CPUID function 1 reports SSE4.2 in bit 20 of ECX.
+    __cpuid(rgCpuInfo, 1);
+    return (rgCpuInfo[2] & (1 << 20)) != 0;
+}
+
+// Decided once per process; the choice does not affect hash values.
+static const bool g_fHardwareCrc32c = IsHardwareCrc32cAvailable();
+
+#endif // STRINGPOOL_HARDWARE_CRC32C
+
+// Fold one byte into the CRC.
+inline
+unsigned long Crc32cByte(
+    unsigned long crc,
+    BYTE b)
+{
+#if STRINGPOOL_HARDWARE_CRC32C
+    if (g_fHardwareCrc32c)
+    {
+        return _mm_crc32_u8(crc, b);
+    }
+#endif
+
+    return (crc >> 8) ^ g_rgulCrc32cTable[(crc ^ b) & 0xFF];
+}
+
+// Fold four bytes (two WCHARs) into the CRC.
+inline
+unsigned long Crc32cLong(
+    unsigned long crc,
+    unsigned long l)
+{
+#if STRINGPOOL_HARDWARE_CRC32C
+    if (g_fHardwareCrc32c)
+    {
+        return _mm_crc32_u32(crc, l);
+    }
+#endif
+
+    crc ^= l;
+    crc = (crc >> 8) ^ g_rgulCrc32cTable[crc & 0xFF];
+    crc = (crc >> 8) ^ g_rgulCrc32cTable[crc & 0xFF];
+    crc = (crc >> 8) ^ g_rgulCrc32cTable[crc & 0xFF];
+    crc = (crc >> 8) ^ g_rgulCrc32cTable[crc & 0xFF];
+
+    return crc;
+}
+
 //============================================================================
 // Computes the hash value of a binary string.  This is used occasionally
 // from outside the string put but not from within.
@@ -752,28 +875,11 @@ unsigned long StringPool::ComputeHashValue(
     BYTE *pb = (BYTE *)pv;
     BYTE *pbEnd = pb + cbSize;
 
-    unsigned long hash = 0;
+    unsigned long hash = 0xFFFFFFFF;
 
     while (pb != pbEnd)
     {
-        BYTE b = *pb++;
-
-        //
-        // The following values are based off loading, but not compiling,
-        // Pretty Printer.  The columns are:
-        //
-        //   buckets used (out of 1024)
-        //   average hash list length
-        //   maximum hash list length
-        //   # of failed string compares
-        //
-
-//      hash = _lrotl(hash, 2) + g_rgulHash[b];                   // 932, 3, 21, 0
-//      hash = _lrotl(hash, 2) + b;                               // 916, 3, 22, 1478
-//      hash = _lrotl(hash, 2) + g_rgulHash[(b + hash) & 0xFF];   // 615, 4, 18, 0
-//      hash = _lrotl(hash, 2) + b * 0x10204081;                  // 967, 2, 9, 0
-        hash = _lrotl(hash, 1) + b * 0x10204081;                  // 968, 2, 9, 0
-//      hash = _lrotl(hash, 2) + b * 0x00204081;                  // 954, 3, 9, 0
+        hash = Crc32cByte(hash, *pb++);
     }
 
     return hash;
@@ -807,7 +913,7 @@ unsigned long _fastcall StringPool::ComputeStringHashValue(
     // terminating NUL in our calculations.  If it's even, we'll
     // skip it.
     //
-    unsigned long hash = 0;
+    unsigned long hash = 0xFFFFFFFF;
     unsigned long l =0 ;
 
 #ifdef _WIN64
@@ -838,14 +944,14 @@ unsigned long _fastcall StringPool::ComputeStringHashValue(
             l = *pl;
 #endif
 
-            hash = _lrotl(hash, 2) + ((l >> 9) + l) * 0x10004001;     // 966, 2, 10, 0
+            hash = Crc32cLong(hash, l);
         }
 
         if (r)
         {
             // simulate the null termination in the case it's not there.
             l = (unsigned)(*((unsigned short *)pl));
-            hash = _lrotl(hash, 2) + ((l >> 9) + l) * 0x10004001;     // 966, 2, 10, 0
+            hash = Crc32cLong(hash, l);
         }
     }
     else    // !CaseSensitive
@@ -899,7 +1005,7 @@ unsigned long _fastcall StringPool::ComputeStringHashValue(
             l = SleazyLowerCasePair(*pl);
 #endif
 
-            hash = _lrotl(hash, 2) + ((l >> 9) + l) * 0x10004001;     // 966, 2, 10, 0
+            hash = Crc32cLong(hash, l);
         }
 
         if (r)
@@ -909,7 +1015,7 @@ unsigned long _fastcall StringPool::ComputeStringHashValue(
             //[....] - DevDivBugs #
             l = SleazyLowerCasePair((*(unsigned short *)pl) | 0x00200000);
 
-            hash = _lrotl(hash, 2) + ((l >> 9) + l) * 0x10004001;     // 966, 2, 10, 0
+            hash = Crc32cLong(hash, l);
         }
 
 #undef SleazyLowerCasePair
@@ -919,6 +1025,37 @@ unsigned long _fastcall StringPool::ComputeStringHashValue(
     return hash;
 }
 
+//============================================================================
+// Lookup a keyword through the keyword perfect hash.  The keyword strings
+// were added in the constructor and m_pstrTokenToString is never modified
+// afterwards, so this does not need the lock.
+//============================================================================
+
+STRING * StringPool::LookupKeywordWithLen(
+    _In_count_(cchSize)const WCHAR * pwchar,
+    size_t cchSize)
+{
+    tokens tk = m_KeywordHashTable.Lookup(pwchar, cchSize);
+
+    if (tk == tkNone)
+    {
+        return NULL;
+    }
+
+    STRING *pstr = m_pstrTokenToString[tk];
+
+    // Only the canonical casing is pooled up front; other casings need their
+    // own spelling and must go through AddStringWithLen.
+    if (!pstr || memcmp(pstr, pwchar, cchSize * sizeof(WCHAR)) != 0)
+    {
+        return NULL;
+    }
+
+    TIMERCOUNT(COUNT_KeywordTableHits, 1);
+
+    return pstr;
+}
+
 //============================================================================
 // Lookup a string without adding it if it isn't already there.
 //============================================================================
@@ -949,7 +1086,8 @@ STRING * StringPool::LookupStringWithLen(
     // the lock.  Putting it outside the lock allows for the most expensive part of the function
     // to execute in parallel
     // Lock after ComputeStringHashValue because 2/3 of the time is spent 
-    CompilerIdeLock lock(m_CriticalSection);
+    PoolSharedLock tableLock(m_TableLock);
+    PoolLock spellingLock(SpellingStripe(ulHash));
 
     index = ulHash & (m_ulSpellingHashTableMask);
     ulCompare = GetCompareValue(cchSize, GetSignificantSpellingHashValue(ulHash));
@@ -998,6 +1136,8 @@ STRING * StringPool::LookupStringWithLen(
         index = ulHash & (m_ulStrInfoHashTableMask);
         ulCompare = GetCompareValue(cchSize, GetSignificantSpellingHashValue(ulHash));
 
+        PoolLock strinfoLock(StrInfoStripe(ulHash));
+
 #if FV_TRACK_MEMORY
         m_cStringAttempts++;
 #endif // DEBUG
@@ -1057,30 +1197,58 @@ STRING *
         return NULL;
     }
 
-    size_t clSizeLong = cchSize >> 1;
-    size_t cchAfterLong = (cchSize) & 1;
-
 #if FV_TRACK_MEMORY
     m_cCalls++;
 #endif // DEBUG
 
-    unsigned ulCompare, ulSpCompare, index, indexSp, ulSpHash, ulHash;
-    Casing *pspelling;
-    STRING_INFO *pstrinfo;
-
     //
     // Check the spelling hash table to see if we can do this via a fast
     // lookup.
     //
 
-    ulSpHash = ComputeStringHashValue((unsigned long *)pwchar, clSizeLong, cchAfterLong, true);
+    unsigned ulSpHash = ComputeStringHashValue((unsigned long *)pwchar, cchSize >> 1, cchSize & 1, true);
 
     // Grab the lock after ComputeStringHashValue.  Profiles show that this method in particular 
     // is very expensive and accounts to up to 2/3 of the entire AddStringWithLength call.  It is 
     // a static method which does not touch any shared variables so it is safe to execute outside
     // the lock.  Putting it outside the lock allows for the most expensive part of the function
     // to execute in parallel
-    CompilerIdeLock lock(m_CriticalSection);
+    bool fAdded = false;
+    STRING *pstr = FindOrAddSpelling(pwchar, cchSize, ulSpHash, &fAdded);
+
+    // expand the tables if necessary.  This needs the table lock exclusively,
+    // so it can only happen after FindOrAddSpelling has released its locks.
+    if (fAdded)
+    {
+        ExpandTablesIfNeeded();
+    }
+
+    // return the string.
+    return pstr;
+}
+
+//============================================================================
+// Find the spelling in the hash tables, adding it if it is not there yet.
+// Only the stripes covering this spelling (and, if the spelling is new, its
+// string info) are locked, so threads interning different names proceed
+// in parallel.
+//============================================================================
+
+STRING * StringPool::FindOrAddSpelling(
+    _In_count_(cchSize)const WCHAR * pwchar,
+    size_t cchSize,
+    unsigned ulSpHash,
+    _Out_ bool * pfAdded)
+{
+    size_t clSizeLong = cchSize >> 1;
+    size_t cchAfterLong = (cchSize) & 1;
+
+    unsigned ulCompare, ulSpCompare, index, indexSp, ulHash;
+    Casing *pspelling;
+    STRING_INFO *pstrinfo;
+
+    PoolSharedLock tableLock(m_TableLock);
+    PoolLock spellingLock(SpellingStripe(ulSpHash));
 
     indexSp = ulSpHash & (m_ulSpellingHashTableMask);
     ulSpCompare = GetCompareValue(cchSize, GetSignificantSpellingHashValue(ulSpHash));
@@ -1124,6 +1292,8 @@ STRING *
     index = ulHash & (m_ulStrInfoHashTableMask);
     ulCompare = GetCompareValue(cchSize, GetSignificantSpellingHashValue(ulHash));
 
+    PoolLock strinfoLock(StrInfoStripe(ulHash));
+
 #if FV_TRACK_MEMORY
     m_cStringAttempts++;
 #endif // DEBUG
@@ -1162,6 +1332,8 @@ STRING *
     //
 
     size_t cbSize;
+    PoolLock allocatorLock(m_CriticalSection);
+
     if (pstrinfo)
     {
         // Allocate the new spelling, aligning it on a 4-byte boundary.
@@ -1245,7 +1417,31 @@ STRING *
     // update the counter
     m_ulSpellingCount++;
 
-    // expand the tables if necessary
+    *pfAdded = true;
+    return pspelling->m_str;
+}
+
+//============================================================================
+// Grow the hash tables once they pass their thresholds.
+//============================================================================
+
+void StringPool::ExpandTablesIfNeeded()
+{
+    {
+        // Cheap check first so that the common case never waits for the
+        // exclusive lock.
+        PoolSharedLock tableLock(m_TableLock);
+        PoolLock lock(m_CriticalSection);
+
+        if (m_ulSpellingCount <= m_ulSpellingThreshold)
+        {
+            return;
+        }
+    }
+
+    PoolExclusiveLock tableLock(m_TableLock);
+
+    // Another thread may have expanded the tables while we waited.
     if (m_ulSpellingCount > m_ulSpellingThreshold)
     {
         ExpandSpellingTable();
@@ -1258,9 +1454,6 @@ STRING *
             ExpandStrInfoTable();
         }
     }
-
-    // return the string.
-    return pspelling->m_str;
 }
 
 // Wrapper that checks whether two strings are case-insensatively equal.
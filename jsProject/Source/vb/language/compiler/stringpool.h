@@ -243,6 +243,13 @@ public:
         _In_opt_count_(cchSize)const WCHAR * pwchar,
         size_t cchSize);
 
+    // Return the pooled spelling of a keyword without taking the pool lock.
+    // Returns NULL unless the text is a keyword spelled exactly as in the
+    // keyword table; callers fall back to AddStringWithLen.
+    STRING * LookupKeywordWithLen(
+        _In_count_(cchSize)const WCHAR * pwchar,
+        size_t cchSize);
+
     // Lookup a string without adding it if it isn't already there.
     STRING * _fastcall LookupStringWithLen(
         _In_count_(cchSize)const WCHAR * pwchar,
@@ -529,19 +536,55 @@ private:
 
     // Keyword tables.
     STRING *m_pstrTokenToString[tkCount];
+    KeywordHashTable m_KeywordHashTable;
 
-    // This critical section is used to serialize access to the underlying shared
-    // memory of the StringPool.  In the IDE, the StringPool can and will be accessed 
-    // from multiple threads and we need to protect the resources which get updated 
-    // and accessed in this context.  In particular this lock is designed to 
-    // protect access to 
+    // The StringPool can and will be accessed from multiple threads (the IDE's
+    // background thread, and the parallel declaration parse of the command line
+    // compiler), so the shared memory of the pool is protected by three levels of
+    // locks, always acquired in this order:
     //
-    //   - m_strinfoHashTable
-    //   - m_spellingHashTable
-    //   - m_ul*
+    //   - m_TableLock is held shared by every lookup and insertion, and exclusive
+    //     while the hash tables are resized.  It protects the table pointers, sizes
+    //     and masks.
+    //   - m_SpellingStripes / m_StrInfoStripes each protect the buckets whose index
+    //     is congruent to the stripe number.  An insertion holds the spelling stripe
+    //     of the new spelling and, if the spelling is new, the strinfo stripe of its
+    //     case-insensitive string.  Threads interning different names rarely meet.
+    //   - m_CriticalSection protects m_nraStrings and the m_ul* counters.
     //
     // All other member variables, while potentially accessed in multiple threads, are
     // initialized to their final state within the StringPool constructor and hence
     // are safe to read from multiple threads
-    CompilerIdeCriticalSection m_CriticalSection;
+    enum
+    {
+        LockStripeCount = 64        // power of 2, no larger than the base table sizes
+    };
+
+    // Unlike the CompilerIde* locks, these are real in every build.
+    typedef CComCritSecLock<SafeCriticalSection> PoolLock;
+    typedef SharedLockHolder<ReaderWriterLock> PoolSharedLock;
+    typedef ExclusiveLockHolder<ReaderWriterLock> PoolExclusiveLock;
+
+    SafeCriticalSection &SpellingStripe(unsigned ulSpellingHash)
+    {
+        return m_SpellingStripes[ulSpellingHash & (LockStripeCount - 1)];
+    }
+
+    SafeCriticalSection &StrInfoStripe(unsigned ulHash)
+    {
+        return m_StrInfoStripes[ulHash & (LockStripeCount - 1)];
+    }
+
+    STRING * FindOrAddSpelling(
+        _In_count_(cchSize)const WCHAR * pwchar,
+        size_t cchSize,
+        unsigned ulSpHash,
+        _Out_ bool * pfAdded);
+
+    void ExpandTablesIfNeeded();
+
+    ReaderWriterLock m_TableLock;
+    SafeCriticalSection m_SpellingStripes[LockStripeCount];
+    SafeCriticalSection m_StrInfoStripes[LockStripeCount];
+    SafeCriticalSection m_CriticalSection;
 };
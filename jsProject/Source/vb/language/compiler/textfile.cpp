@@ -27,7 +27,6 @@ HRESULT TextFile::GetFileText(
 { 
 
     HRESULT hr = NOERROR;
-    BSTR    bstrText = NULL;
     WCHAR*  wszFileContents = 0;
     size_t  cchFileSize = 0;
     LTI_INFO lti = LTIF_SIGNATURE | LTIF_DETECT;
@@ -269,11 +268,6 @@ HRESULT TextFile::GetFileText(
         hr = NOERROR;
     }
 
-    if (bstrText)
-    {
-        ::SysFreeString(bstrText);
-    }
-
     return hr;
 
 }
@@ -513,7 +507,56 @@ HRESULT TextFile::LoadTextFileFromBytes(
 
         pnra->Mark(&mark);
         IfFailThrow(GetImageFormat2(lti, dwSize, pData, &ltiOut));
-        IfFailThrow(TextImageUnicodeSize(ltiOut, dwSize, pData, (DWORD*)&cchFileSizeOut));
+
+        if (LTI_CP(ltiOut) == CP_UTF8)
+        {
+            // Most source is UTF-8 and almost all of it ASCII, so convert it in a
+            // single pass instead of sizing it first.  A UTF-8 file never has more
+            // UTF-16 characters than bytes, so allocate that many and give back
+            // what isn't used.
+            const BYTE * pText = pData;
+            size_t cbText = dwSize;
+
+            if (LTIF_SIGNATURE & ltiOut)
+            {
+                VSASSERT(cbText >= UTF8SIGLEN && memcmp(pText, UTF8SIG, UTF8SIGLEN) == 0, "Bad UTF-8 signature.");
+                pText += UTF8SIGLEN;
+                cbText -= UTF8SIGLEN;
+            }
+
+            if (cbText > 0)
+            {
+                size_t cbAlloc = VBMath::Multiply(cbText, sizeof(WCHAR));
+
+                wszFileContentsOut = (WCHAR*)pnra->AllocNonZero(cbAlloc);
+                cchFileSizeOut = UTF8ToUnicodeFast(pText, cbText, wszFileContentsOut);
+
+                if (cchFileSizeOut > 0)
+                {
+                    wszFileContentsOut = (WCHAR*)pnra->Resize(
+                        wszFileContentsOut,
+                        cbAlloc,
+                        cchFileSizeOut * sizeof(WCHAR));
+                }
+                else
+                {
+                    // Nothing but an incomplete character.
+                    pnra->Free(&mark);
+                }
+            }
+        }
+        else
+        {
+            IfFailThrow(TextImageUnicodeSize(ltiOut, dwSize, pData, (DWORD*)&cchFileSizeOut));
+
+            if (cchFileSizeOut != 0)
+            {
+                wszFileContentsOut = (WCHAR*)pnra->Alloc(VBMath::Multiply(
+                    cchFileSizeOut, 
+                    sizeof(WCHAR)));
+                IfFailThrow(TextImageToUnicode(ltiOut, false, dwSize, pData, (DWORD)cchFileSizeOut, wszFileContentsOut));
+            }
+        }
 
         if (cchFileSizeOut == 0)
         {
@@ -524,13 +567,6 @@ HRESULT TextFile::LoadTextFileFromBytes(
             cchFileSizeOut = 0;
             hr = S_OK;
         }
-        else
-        {
-            wszFileContentsOut = (WCHAR*)pnra->Alloc(VBMath::Multiply(
-                cchFileSizeOut, 
-                sizeof(WCHAR)));
-            IfFailThrow(TextImageToUnicode(ltiOut, false, dwSize, pData, (DWORD)cchFileSizeOut, wszFileContentsOut));
-        }
     }
     else
     {
@@ -550,6 +586,94 @@ HRESULT TextFile::LoadTextFileFromBytes(
 }
 
 
+//============================================================================
+// UTF8ToUnicodeFast
+//
+// Converts UTF-8 to UTF-16 exactly like UTF8ToUnicode does, but widens runs of
+// ASCII a machine word at a time.  wszOut must have room for cbData
+// characters; returns the number written.
+//============================================================================
+size_t TextFile::UTF8ToUnicodeFast(
+    _In_count_(cbData) const BYTE * pData,
+    size_t cbData,
+    _Out_cap_(cbData) WCHAR * wszOut)
+{
+    const UINT64 NonAsciiMask = 0x8080808080808080;
+
+    const BYTE * pIn = pData;
+    const BYTE * pInEnd = pData + cbData;
+    WCHAR * pOut = wszOut;
+
+    while (pIn < pInEnd)
+    {
+        // ASCII, eight bytes at a time.
+        while ((size_t)(pInEnd - pIn) >= sizeof(UINT64))
+        {
+            UINT64 Bytes;
+            memcpy(&Bytes, pIn, sizeof(Bytes));
+
+            if (Bytes & NonAsciiMask)
+            {
+                break;
+            }
+
+            for (unsigned i = 0; i < sizeof(UINT64); i++)
+            {
+                pOut[i] = pIn[i];
+            }
+
+            pIn += sizeof(UINT64);
+            pOut += sizeof(UINT64);
+        }
+
+        while (pIn < pInEnd && *pIn < 0x80)
+        {
+            *pOut++ = *pIn++;
+        }
+
+        if (pIn == pInEnd)
+        {
+            break;
+        }
+
+        // A lead byte and its trail bytes.  A complete sequence of two to four
+        // bytes converts the same on its own as in the middle of the text.  For
+        // anything else UTF8ToUnicode has to carry its state forward, so let it
+        // do the rest of the text.
+        unsigned cbSequence = 0;
+
+        for (BYTE Lead = *pIn; Lead & 0x80; Lead <<= 1)
+        {
+            cbSequence++;
+        }
+
+        bool IsComplete = cbSequence >= 2 && cbSequence <= 4 && (size_t)(pInEnd - pIn) >= cbSequence;
+
+        for (unsigned i = 1; IsComplete && i < cbSequence; i++)
+        {
+            IsComplete = (pIn[i] & 0xC0) == 0x80;
+        }
+
+        // Every byte in gives at most one character out, so the rest of the
+        // output buffer always holds the rest of the input.
+        int cchRemaining = (int)(pInEnd - pIn);
+
+        if (!IsComplete)
+        {
+            pOut += UTF8ToUnicode((PCSTR)pIn, cchRemaining, pOut, cchRemaining);
+            break;
+        }
+
+        pOut += UTF8ToUnicode((PCSTR)pIn, cbSequence, pOut, cchRemaining);
+        pIn += cbSequence;
+    }
+
+    VSASSERT(pOut - wszOut <= (ptrdiff_t)cbData, "Overran the output buffer.");
+
+    return pOut - wszOut;
+}
+
+
 // Compute MD5 hash for PDB check sum by using vscommon\crypthash.lib
 // this function mimics GetTextFile(), make sure they are in [....] when new text sources are added
 
@@ -563,7 +687,6 @@ HRESULT TextFile::GetCryptHash(
     void *pvText = NULL;
     size_t cbText = 0;
     BYTE* pFileContents = NULL;
-    CryptHash *psh = NULL;
     HANDLE hMap = NULL;
     BYTE* pData = NULL;
     bool newHFile = false;
@@ -715,17 +838,11 @@ HRESULT TextFile::GetCryptHash(
         }
 
         // compute the hash
-        if (SUCCEEDED(hr) && pvText && CryptHash::CreateCryptHashAlgorithm(&psh, CALG_MD5))
+        if (SUCCEEDED(hr) && pvText && ComputeCryptHash(pvText, cbText, pvHashValue))
         {
-            if (psh->SetCryptHashData((LPCVOID)pvText,cbText))
-            {
-                psh->GetCryptHash(pvHashValue,cbHashSize);
-                hrCrypt = NOERROR;
-            }
-            psh->Close();
-
+            hrCrypt = NOERROR;
 
-            if (m_pTextFileCacheRef && pvHashValue)
+            if (m_pTextFileCacheRef)
             {
                 m_pTextFileCacheRef->SetCryptHash(pvHashValue);
             }
@@ -794,6 +911,29 @@ HRESULT TextFile::GetCryptHash(
 
 }
 
+//============================================================================
+// The MD5 hash of a file's bytes, as reported by GetCryptHash.
+//============================================================================
+bool TextFile::ComputeCryptHash(
+    _In_bytecount_(cbData) const void * pvData,
+    size_t cbData,
+    _Out_bytecap_(CRYPT_HASHSIZE) void * pvHashValue)
+{
+    CryptHash *psh = NULL;
+    bool fHashed = false;
+
+    if (CryptHash::CreateCryptHashAlgorithm(&psh, CALG_MD5))
+    {
+        fHashed =
+            psh->SetCryptHashData(pvData, cbData) &&
+            psh->GetCryptHash(pvHashValue, CRYPT_HASHSIZE);
+
+        psh->Close();
+    }
+
+    return fHashed;
+}
+
 //============================================================================
 // TemporaryFile::TemporaryFile
 //============================================================================
@@ -971,6 +1111,7 @@ void TemporaryFile::Close()
 //============================================================================
 TextFileCacheRef::TextFileCacheRef()
 {
+    m_hSection = NULL;
     m_Offset = 0;
     m_Size = 0;
     m_IsUnicode = false;
@@ -983,11 +1124,13 @@ TextFileCacheRef::TextFileCacheRef()
 // TextFileCacheRef::TextFileCacheRef
 //============================================================================
 TextFileCacheRef::TextFileCacheRef(
-    LONG offset,
+    HANDLE hSection,
+    size_t offset,
     DWORD size,
     const FILETIME &timestamp,
     const bool IsDetectUTF8WithoutSig)
 {
+    m_hSection = hSection;
     m_Offset = offset;
     m_Size = size;
     m_IsUnicode = false;
@@ -1001,7 +1144,8 @@ TextFileCacheRef::TextFileCacheRef(
 //============================================================================
 bool TextFileCacheRef::operator ==(const TextFileCacheRef &e) const
 {
-    return (m_Offset == e.m_Offset &&
+    return (m_hSection == e.m_hSection &&
+            m_Offset == e.m_Offset &&
             m_Size == e.m_Size &&
             m_Timestamp.dwLowDateTime == e.m_Timestamp.dwLowDateTime &&
             m_Timestamp.dwHighDateTime == e.m_Timestamp.dwHighDateTime);
@@ -1015,90 +1159,50 @@ bool TextFileCacheRef::operator !=(const TextFileCacheRef &e) const
     return !(*this == e);
 }
 
-//============================================================================
-// TextFileCache::EntryHeader::EntryHeader
-//============================================================================
-TextFileCache::EntryHeader::EntryHeader(
-    DWORD size,
-    const FILETIME &timestamp)
-{
-    m_Size = size;
-    m_Timestamp = timestamp;
-};
-
-//============================================================================
-// TextFileCache::EntryHeader::EntryHeader
-//============================================================================
-TextFileCache::EntryHeader::EntryHeader()
-{
-    m_Size = 0;
-    m_Timestamp = TextFileCache::NullFileTime;
-};
-
 //============================================================================
 // TextFileCache::NullFileTime
 //============================================================================
 const FILETIME TextFileCache::NullFileTime = {0, 0};
 
-//-------------------------------------------------------------------------------------------------
-//
-// Determine if the underlying file for the cache is currently open
-//
-//-------------------------------------------------------------------------------------------------
-bool
-TextFileCache::IsOpen()
-{
-    return m_TempFile.IsValidHandle();
-}
+// The size of the sections the store grows by.  Entries bigger than a
+// quarter of this get a section of their own.
+#define TEXTFILECACHE_SEGMENT_SIZE  (4 * 1024 * 1024)
 
 //============================================================================
-// TextFileCache::EnsureOpen
-// Opens the temporary file for the TextFileCache.
-// Will throw an error if the file cannot be opened.
-//
-// The TextFileCache is now loaded on demand for performance reasons.  The 
-// key scenario is the EE.  The EE uses CompilerProject as a place and
-// context in which to perform an evaluation.  However intstead of reading
-// source code from a file, it directly hands parse trees to the Semantics
-// engine.  This renders the creation of a temporary file un-necessary.
-//
-// The creation of a temporary file turns out to be a significant cost for
-// debugger stepping scenarios.  In particular in calculating the contents
-// of the stack window.  The VB EE acounts for around 10% of the entire scenario
-// with the creation of the temorpary file accountig for 3-5% of the EE's
-// 10%.  So now we delay the creation of the temporary file until it's 
-// actually needed
-//
+// TextFileCache::Close
+// Closes the store and forgets all the entries.  Any TextFileCacheRef
+// still around is left dangling, so this is only for when the project
+// goes away.
 //============================================================================
-void
-TextFileCache::EnsureOpen()
+void TextFileCache::Close()
 {
-    // Protect access to the temp file
-    CompilerIdeLock lock(m_CriticalSection);
-    if ( !IsOpen() )
+    SafeCriticalSectionLock lock(m_CriticalSection);
+
+    Segment * pSegment = m_pSegments;
+
+    while (pSegment)
     {
-        m_TempFile.Open(L"vbc");    
+        Segment * pNext = pSegment->m_pNext;
+
+        CloseHandle(pSegment->m_hSection);
+        delete pSegment;
+
+        pSegment = pNext;
     }
-}
 
-//============================================================================
-// TextFileCache::Close
-// Closes the temporary file for the TextFileCache.
-//============================================================================
-void TextFileCache::Close()
-{
-    // Protect access to the temp file
-    CompilerIdeLock lock(m_CriticalSection);
-    m_TempFile.Close();
+    m_pSegments = NULL;
+    m_pShared = NULL;
+    m_NextFree = 0;
+
+    m_Entries.Clear();
+    m_nraEntries.FreeHeap();
 }
 
 //============================================================================
 // TextFileCache::Append
-// Appends a block to the file cache. The bock consists of a header
-// that contains the timestamp and length of the block, followed
-// by the actual data bytes.
-// A new TextFileCacheRef is returned which is used to read this block
-// back out of the cache.
+// Adds a block to the cache, unless a block with the same contents is
+// already there.  A new TextFileCacheRef is returned which is used to read
+// the block back out of the cache.
 //============================================================================
 TextFileCacheRef * TextFileCache::Append(
     LPVOID lpBuffer,
@@ -1106,63 +1210,156 @@ TextFileCacheRef * TextFileCache::Append(
     const FILETIME &ftTimestamp,
     const bool IsDetectUTF8WithoutSig)
 {
-    EnsureOpen();
-    TextFileCacheRef* pTextFileCacheRef = NULL;
-    HRESULT hr = S_OK;
+    DWORD crc = CRC32(lpBuffer, cbBytes);
+
+    HANDLE hSection = NULL;
+    size_t offset = 0;
 
     {
-        // Protect access to the temp file
-        CompilerIdeLock lock(m_CriticalSection);
+        // Protect the store and the entries
+        SafeCriticalSectionLock lock(m_CriticalSection);
 
-        LONG                newOffset;
-        DWORD               bytesWritten;
-        EntryHeader         header(cbBytes, ftTimestamp);
+        Entry * pFirst = NULL;
+        m_Entries.GetValue(crc, &pFirst);
 
-        // Seek to the end of the cache file
-        newOffset = SetFilePointer(m_TempFile.GetHandle(), 0, NULL, FILE_END);
-        if ((newOffset == INVALID_SET_FILE_POINTER) && (GetLastError() != NO_ERROR))
-        {
-            VbThrow(GetLastHResultError());
-        }
-#if IDE
-        if (newOffset < 0)
+        for (Entry * pEntry = pFirst; pEntry && !hSection; pEntry = pEntry->m_pNext)
         {
-            // Dev11 344896
-            // Our file size went over 2GB.  Let's throw away this temp file.  A new one will be created
-            // and all the text files will be reread from disk until they've each been placed in the
-            // new cache.  This will cause some asserts, but should only occur in stress scenarios.
-            m_TempFile.Close();
-            VbThrowNoAssert(E_FAIL);
-        }
-#endif
-        // Write the header element
-        if (!WriteFile(m_TempFile.GetHandle(), (LPVOID)&header, sizeof(header), &bytesWritten, NULL))
-        {
-            VbThrow(GetLastHResultError());
+            if (pEntry->m_Size == cbBytes)
+            {
+                void * pvView = NULL;
+                BYTE * pbData = MapData(pEntry->m_hSection, pEntry->m_Offset, cbBytes, FILE_MAP_READ, &pvView);
+
+                if (memcmp(pbData, lpBuffer, cbBytes) == 0)
+                {
+                    hSection = pEntry->m_hSection;
+                    offset = pEntry->m_Offset;
+                }
+
+                UnmapViewOfFile(pvView);
+            }
         }
 
-        // Write the file text
-        if (!WriteFile(m_TempFile.GetHandle(), lpBuffer, cbBytes, &bytesWritten, NULL))
+        if (!hSection)
         {
-            VbThrow(GetLastHResultError());
+            AllocData(cbBytes, &hSection, &offset);
+
+            void * pvView = NULL;
+            BYTE * pbData = MapData(hSection, offset, cbBytes, FILE_MAP_WRITE, &pvView);
+            memcpy(pbData, lpBuffer, cbBytes);
+            UnmapViewOfFile(pvView);
+
+            Entry * pEntry = new(m_nraEntries) Entry;
+            pEntry->m_crc = crc;
+            pEntry->m_Size = cbBytes;
+            pEntry->m_hSection = hSection;
+            pEntry->m_Offset = offset;
+            pEntry->m_pNext = pFirst;
+            m_Entries.SetValue(crc, pEntry);
         }
+    }
+
+    TextFileCacheRef * pTextFileCacheRef = new (zeromemory) TextFileCacheRef(hSection, offset, cbBytes, ftTimestamp, IsDetectUTF8WithoutSig);
+    IfNullThrow(pTextFileCacheRef);
+
+    return pTextFileCacheRef;
+}
+
+//============================================================================
+// TextFileCache::AllocData
+// Finds room for an entry's bytes, creating a new section if need be.
+//============================================================================
+void TextFileCache::AllocData(
+    DWORD cbBytes,
+    _Out_ HANDLE * phSection,
+    _Out_ size_t * pOffset)
+{
+    size_t cbAlloc = VBMath::RoundUpAllocSize(cbBytes ? cbBytes : 1);
 
-        // Success. Allocate the output object
-        pTextFileCacheRef = new (zeromemory) TextFileCacheRef(newOffset, cbBytes, ftTimestamp, IsDetectUTF8WithoutSig);
-        IfNullThrow(pTextFileCacheRef);
+    if (cbAlloc > TEXTFILECACHE_SEGMENT_SIZE / 4)
+    {
+        // Don't waste the rest of the shared section on this one.
+        *phSection = NewSegment(cbAlloc)->m_hSection;
+        *pOffset = 0;
+        return;
     }
 
-    if (FAILED(hr))
+    if (!m_pShared || TEXTFILECACHE_SEGMENT_SIZE - m_NextFree < cbAlloc)
     {
-        VbThrow(hr);
+        m_pShared = NewSegment(TEXTFILECACHE_SEGMENT_SIZE);
+        m_NextFree = 0;
     }
 
-    return pTextFileCacheRef;
+    *phSection = m_pShared->m_hSection;
+    *pOffset = m_NextFree;
+    m_NextFree += cbAlloc;
+}
+
+//============================================================================
+// TextFileCache::NewSegment
+// Creates a new section of cbSize bytes, backed by the paging file.  Throws
+// if the section can't be created.
+//============================================================================
+TextFileCache::Segment * TextFileCache::NewSegment(size_t cbSize)
+{
+    ULARGE_INTEGER Size;
+    Size.QuadPart = cbSize;
+
+    HANDLE hSection = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, Size.HighPart, Size.LowPart, NULL);
+
+    if (!hSection)
+    {
+        VbThrow(GetLastHResultError());
+    }
+
+    Segment * pSegment = new (zeromemory) Segment;
+    pSegment->m_hSection = hSection;
+    pSegment->m_pNext = m_pSegments;
+    m_pSegments = pSegment;
+
+    return pSegment;
+}
+
+//============================================================================
+// TextFileCache::MapData
+// Maps the bytes of an entry.  Views have to start on the allocation
+// granularity, so the view may begin before the entry.  Throws if the
+// view can't be mapped.
+//============================================================================
+BYTE * TextFileCache::MapData(
+    HANDLE hSection,
+    size_t offset,
+    DWORD cbBytes,
+    DWORD dwDesiredAccess,
+    _Out_ void ** ppvView)
+{
+    static DWORD s_dwAllocationGranularity = 0;
+
+    if (!s_dwAllocationGranularity)
+    {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        s_dwAllocationGranularity = si.dwAllocationGranularity;
+    }
+
+    ULARGE_INTEGER ViewOffset;
+    ViewOffset.QuadPart = offset - offset % s_dwAllocationGranularity;
+
+    size_t cbSkip = (size_t)(offset - ViewOffset.QuadPart);
+
+    void * pvView = MapViewOfFile(hSection, dwDesiredAccess, ViewOffset.HighPart, ViewOffset.LowPart, VBMath::Add(cbSkip, cbBytes ? cbBytes : 1));
+
+    if (!pvView)
+    {
+        VbThrow(GetLastHResultError());
+    }
+
+    *ppvView = pvView;
+    return (BYTE *)pvView + cbSkip;
 }
 
 //============================================================================
 // TextFileCache::Read
-// Reads a block of data out of the cache file. This version doesn't test
+// Reads a block of data out of the cache. This version doesn't test
 // whether the block is out-of-date with respect to the file that it
 // came from.
 //============================================================================
@@ -1176,12 +1373,12 @@ DWORD TextFileCache::Read(
 
 //============================================================================
 // TextFileCache::Read
-// Reads a block of data out of the cache file.
+// Reads a block of data out of the cache.
 // If wszFileName is non-null, it will check whether the last-write-time for
 // the file is equal to the value specified in pRef. If not, it will
 // throw an error.
-// The header block in the cache is also tested against pElelement. If the
-// size or timesamp don't macth, it will throw an error.
+// Entries don't change once they are added, so no lock is taken; the
+// entry is mapped just for the copy.
 //============================================================================
 DWORD TextFileCache::Read
 (
@@ -1191,78 +1388,41 @@ DWORD TextFileCache::Read
     DWORD                   cbBytes
 )
 {
-    EnsureOpen();
-    DWORD bytesRead = 0;
-    HRESULT hr = S_OK;
-
+    // Check if the cache timestamp is curent
+    if (wszFileName)
     {
-        // Protext access to the temp file
-        CompilerIdeLock lock(m_CriticalSection);
-
-        LONG newOffset;
-
-        // Check if the cache timestamp is curent
-        if (wszFileName)
-        {
-            FILETIME ftCache = pRef->GetTimestamp();
-            FILETIME ftCurrent;
-            GetFileModificationTime(wszFileName, &ftCurrent);
-
-            if (ftCurrent.dwLowDateTime != ftCache.dwLowDateTime ||
-                ftCurrent.dwHighDateTime != ftCache.dwHighDateTime)
-            {
-                VbThrowNoAssert(E_FAIL);
-            }
-        }
-
-        // Find and reaad the cache element.
-        newOffset = SetFilePointer(m_TempFile.GetHandle(), pRef->GetOffset(), NULL, FILE_BEGIN);
-        if ((newOffset == INVALID_SET_FILE_POINTER) && (GetLastError() != NO_ERROR))
-        {
-            VbThrow(GetLastHResultError());
-        }
+        FILETIME ftCache = pRef->GetTimestamp();
+        FILETIME ftCurrent;
+        GetFileModificationTime(wszFileName, &ftCurrent);
 
-        // Read in the header
-        EntryHeader header;
-        if (!ReadFile(m_TempFile.GetHandle(),&header, sizeof(header), &bytesRead, NULL))
+        if (ftCurrent.dwLowDateTime != ftCache.dwLowDateTime ||
+            ftCurrent.dwHighDateTime != ftCache.dwHighDateTime)
         {
-            VbThrow(GetLastHResultError());
-        }
-
-        TextFileCacheRef thisRef(newOffset, header.m_Size, header.m_Timestamp);
-
-        // Verify that the data matches the requested TextFileCacheRef
-        if (thisRef != *pRef)
-        {
-            VbThrow(E_FAIL);
+            VbThrowNoAssert(E_FAIL);
         }
+    }
 
-        if (cbBytes > 0)
-        {
-            // Verify that the caller's buffer is large enough
-            if (cbBytes < header.m_Size)
-            {
-                VbThrow(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
-            }
+    if (!pRef->GetSection())
+    {
+        VbThrow(E_FAIL);
+    }
 
-            // Read the data
-            if (!ReadFile(m_TempFile.GetHandle(), lpBuffer, header.m_Size, &bytesRead, NULL))
-            {
-                VbThrow(GetLastHResultError());
-            }
-        }
-        else
-        {
-            bytesRead = 0;
-        }
+    if (cbBytes == 0)
+    {
+        return 0;
     }
 
-    // re-throw errors to the caller
-    if (FAILED(hr))
+    // Verify that the caller's buffer is large enough
+    if (cbBytes < pRef->GetSize())
     {
-        VbThrow(hr);
+        VbThrow(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
     }
 
-    return bytesRead;
-}
+    void * pvView = NULL;
+    const BYTE * pbData = MapData(pRef->GetSection(), pRef->GetOffset(), pRef->GetSize(), FILE_MAP_READ, &pvView);
+
+    memcpy(lpBuffer, pbData, pRef->GetSize());
+    UnmapViewOfFile(pvView);
 
+    return pRef->GetSize();
+}
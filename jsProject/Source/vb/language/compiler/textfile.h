@@ -131,6 +131,18 @@ private:
         __deref_out_ecount_opt(* pcchFileSize)WCHAR * * pwszFileContents,  // [out] unicode characters
         _Out_ size_t * pcchFileSize); // [out] number of unicode characters
 
+    static
+    bool ComputeCryptHash(
+        _In_bytecount_(cbData) const void * pvData,
+        size_t cbData,
+        _Out_bytecap_(CRYPT_HASHSIZE) void * pvHashValue);
+
+    static
+    size_t UTF8ToUnicodeFast(
+        _In_count_(cbData) const BYTE * pData,
+        size_t cbData,
+        _Out_cap_(cbData) WCHAR * wszOut);
+
 
 private:
 
@@ -189,7 +201,7 @@ private:
         const BYTE * pFileContents,
         size_t cbFileSize,
         const FILETIME &timestamp,
-        const bool IsDetectUTF8WithoutSig = true);
+        const bool IsDetectUTF8WithoutSig);
 
     void WriteUnicodeSourceFileCache(
         _In_count_(cchFileSize)const WCHAR * pFileContents,
@@ -227,9 +239,9 @@ private:
 
 //
 // The TextFileCacheRef object points to an entry in
-// the TextFileCache. The offset, size and timestamp
-// of the entry are maintained to ensure that the
-// element in the caches matches the reference.
+// the TextFileCache. The size and timestamp of the
+// file the entry was made from are kept so that the
+// reference can be checked against the file on disk.
 //
 class TextFileCacheRef
 {
@@ -239,12 +251,18 @@ public:
     TextFileCacheRef();
 
     TextFileCacheRef(
-        LONG offset,
+        HANDLE hSection,
+        size_t offset,
         DWORD size,
         const FILETIME &lastWriteTime,
         const bool IsDetectUTF8WithoutSig = true);
 
-    LONG GetOffset() const 
+    HANDLE GetSection() const 
+    {
+         return m_hSection; 
+    }
+
+    size_t GetOffset() const 
     {
          return m_Offset; 
     }
@@ -300,7 +318,8 @@ public:
     bool operator !=(const TextFileCacheRef &e) const;
 
 private:
-    LONG                m_Offset;   // bytes
+    HANDLE              m_hSection; // the section of the cache's store holding the entry
+    size_t              m_Offset;   // of the entry in the section
     DWORD               m_Size;     // bytes
     BYTE                m_bCryptHash[CRYPT_HASHSIZE];
     FILETIME            m_Timestamp;
@@ -311,18 +330,37 @@ private:
 
 
 //
-// The TextFileCache manages a temporary file that contains the
-// cached contents of text files. Each entry in the temp file
-// contains a header that consists of the size and timestamp of
-// the entry, followed by the actual bits.
+// The TextFileCache keeps the contents of text files, so that
+// they don't have to be opened, read and converted every time
+// they are needed.
+//
+// Entries are addressed by content: a CRC of the converted
+// text and its size, with the bytes compared when those match.
+// Loading a file whose contents are already cached, say because
+// it was touched but not changed, or is part of the project
+// twice, finds the existing entry instead of storing another
+// copy.
+//
+// The contents live in sections backed by the paging file, like
+// the temp file the cache used to write to.  The store grows a
+// section at a time, without the 2GB limit the temp file had
+// (Dev11 344896).  The sections are not kept mapped, which would
+// use up the address space of the 32 bit IDE; Append and Read
+// map just the bytes of the one entry while they copy them.
+// Entries are never moved or freed before Close, so reading
+// takes no lock; only Append does.
 //
 class TextFileCache
 {
 public:
 
-    TextFileCache(Compiler * pCompiler) 
+    TextFileCache(Compiler * pCompiler) :
+        m_nraEntries(NORLSLOC)
     {
          m_pCompiler = pCompiler; 
+         m_pSegments = NULL;
+         m_pShared = NULL;
+         m_NextFree = 0;
     }
 
     ~TextFileCache()
@@ -330,9 +368,10 @@ public:
         Close();
     }
 
-    bool IsOpen();
     void Close();
 
+    // Adds the converted contents of a file, or finds the entry that
+    // already holds them.
     TextFileCacheRef * Append(
         LPVOID lpBuffer,
         DWORD cbBytes,
@@ -354,19 +393,46 @@ public:
 
 private:
 
-    void EnsureOpen();
-    struct EntryHeader
+    struct Entry
     {
-        EntryHeader();
-        EntryHeader(
-            DWORD size,
-            const FILETIME &lastWriteTime);
-
+        DWORD           m_crc;
         DWORD           m_Size;
-        FILETIME        m_Timestamp;
+        HANDLE          m_hSection;
+        size_t          m_Offset;
+        Entry *         m_pNext;    // next entry with the same CRC
     };
 
+    // A section of the store.
+    struct Segment
+    {
+        HANDLE          m_hSection;
+        Segment *       m_pNext;
+    };
+
+    // Maps the cbBytes at offset in hSection.  The view to unmap
+    // is returned in *ppvView.
+    static BYTE * MapData(
+        HANDLE hSection,
+        size_t offset,
+        DWORD cbBytes,
+        DWORD dwDesiredAccess,
+        _Out_ void ** ppvView);
+
+    // The caller holds m_CriticalSection.
+    void AllocData(DWORD cbBytes, _Out_ HANDLE * phSection, _Out_ size_t * pOffset);
+    Segment * NewSegment(size_t cbSize);
+
     Compiler*           m_pCompiler;
-    TemporaryFile       m_TempFile;
-    CompilerIdeCriticalSection m_CriticalSection;
+
+    // Real in every build: the command line compiler loads the files of a
+    // project on several threads when it parses them in parallel.  Only
+    // writers take it.
+    SafeCriticalSection m_CriticalSection;
+
+    NorlsAllocator      m_nraEntries;
+    DynamicHashTable<DWORD, Entry *> m_Entries;
+
+    Segment *           m_pSegments;
+    Segment *           m_pShared;      // the newest segment shared by small entries
+    size_t              m_NextFree;     // in m_pShared
 };
@@ -76,6 +76,7 @@ typedef CComCritSecLock<CompilerIdeCriticalSection> CompilerIdeLock;
 #include "..\Compiler\WerExceptionReport.h"
 #include "..\Compiler\SequentialNameGenerator.h"
 #include "..\Compiler\logging.h"
+#include "..\Compiler\ParallelWork.h"
 
 // Lexical and syntax analysis
 #include "..\Compiler\Types.h"
@@ -100,6 +101,7 @@ typedef CComCritSecLock<CompilerIdeCriticalSection> CompilerIdeLock;
 
 #include "..\Compiler\Parser\ParseTreeVisitor.h"
 #include "..\Compiler\Parser\LocationFixupVisitor.h"
+#include "..\Compiler\Parser\MethodBodyCache.h"
 #include "..\Compiler\MapFile.h"
 
 // Symbols
@@ -87,3 +87,87 @@ typedef CComAutoCriticalSection SafeCriticalSection;
 
 typedef CComCritSecLock<SafeCriticalSection> SafeCriticalSectionLock;
 
+
+//-------------------------------------------------------------------------------------------------
+//
+// Slim reader/writer lock.  Readers share the lock; a writer excludes everyone.
+// Not recursive: a thread holding the lock in either mode must not acquire it again.
+//
+//-------------------------------------------------------------------------------------------------
+class ReaderWriterLock
+{
+public:
+    ReaderWriterLock()
+    {
+        InitializeSRWLock(&m_lock);
+    }
+
+    void EnterShared()
+    {
+        AcquireSRWLockShared(&m_lock);
+    }
+
+    void LeaveShared()
+    {
+        ReleaseSRWLockShared(&m_lock);
+    }
+
+    void EnterExclusive()
+    {
+        AcquireSRWLockExclusive(&m_lock);
+    }
+
+    void LeaveExclusive()
+    {
+        ReleaseSRWLockExclusive(&m_lock);
+    }
+
+private:
+    // Do not generate
+    ReaderWriterLock(const ReaderWriterLock&);
+    ReaderWriterLock& operator=(const ReaderWriterLock&);
+
+    SRWLOCK m_lock;
+};
+
+template <typename LockType>
+class SharedLockHolder
+{
+public:
+    explicit SharedLockHolder(LockType &lock) : m_lock(lock)
+    {
+        m_lock.EnterShared();
+    }
+
+    ~SharedLockHolder()
+    {
+        m_lock.LeaveShared();
+    }
+
+private:
+    SharedLockHolder(const SharedLockHolder&);
+    SharedLockHolder& operator=(const SharedLockHolder&);
+
+    LockType &m_lock;
+};
+
+template <typename LockType>
+class ExclusiveLockHolder
+{
+public:
+    explicit ExclusiveLockHolder(LockType &lock) : m_lock(lock)
+    {
+        m_lock.EnterExclusive();
+    }
+
+    ~ExclusiveLockHolder()
+    {
+        m_lock.LeaveExclusive();
+    }
+
+private:
+    ExclusiveLockHolder(const ExclusiveLockHolder&);
+    ExclusiveLockHolder& operator=(const ExclusiveLockHolder&);
+
+    LockType &m_lock;
+};
@@ -32,13 +32,8 @@
  
 
 NorlsAllocator::NorlsAllocator( 
-#if NRLSTRACK
      _In_ WCHAR *szFile
     , _In_ long nLineNo
-#else
-    _In_ int nUnused 
-
-#endif NRLSTRACK
 ) :
     m_heapPage(g_pvbNorlsManager->GetPageHeap()),
     m_depth(0)
@@ -57,15 +52,11 @@ NorlsAllocator::NorlsAllocator(
 #endif NRLSTRACK_GETSTACKS    
 #endif NRLSTRACK
     
-    Init(ProtectedEntityFlags::Other);
+    Init(ProtectedEntityFlags::Other, szFile, nLineNo);
 }
 
 NorlsAllocator::NorlsAllocator( 
-#if NRLSTRACK
      _In_ WCHAR *szFile, _In_ long nLineNo,
-#else
-    _In_ int nUnused,
-#endif NRLSTRACK
     _In_ PageHeap& heapToAllocateFrom
 ) :
     m_heapPage(heapToAllocateFrom),
@@ -83,7 +74,7 @@ NorlsAllocator::NorlsAllocator(
     m_pLastBlock = NULL;
 #endif NRLSTRACK_GETSTACKS    
 #endif NRLSTRACK
-    Init(ProtectedEntityFlags::Other);
+    Init(ProtectedEntityFlags::Other, szFile, nLineNo);
 }
 
 /*
@@ -98,7 +89,7 @@ NorlsAllocator::NorlsAllocator(PageHeap& pageHeap, const WCHAR* heapName, Protec
 }
 */
 
-void NorlsAllocator::Init(ProtectedEntityFlagsEnum entity)
+void NorlsAllocator::Init(ProtectedEntityFlagsEnum entity, _In_z_ WCHAR *szFile, long nLineNo)
 {
     nextFree = limitFree = NULL;
     pageList = pageLast = NULL;
@@ -106,6 +97,23 @@ void NorlsAllocator::Init(ProtectedEntityFlagsEnum entity)
     anyPageMarkedReadOnly = false;
     inAllowingWrite = false;
     this->entity = entity;
+
+    m_pSite = NorlsAllocProfiler::GetSite(szFile, nLineNo);
+    InterlockedIncrement(&m_pSite->cAllocators);
+    m_cbLive = m_cbPending = m_cPending = 0;
+}
+
+/*
+ * Fold the locally accumulated allocation counts into the allocator's site.
+ */
+void NorlsAllocator::ReportToSite()
+{
+    if (m_cPending)
+    {
+        InterlockedExchangeAdd64(&m_pSite->cbAllocated, (LONGLONG)m_cbPending);
+        InterlockedExchangeAdd64(&m_pSite->cAllocations, (LONGLONG)m_cPending);
+        m_cbPending = m_cPending = 0;
+    }
 }
 
 NorlsAllocator::~NorlsAllocator()
@@ -122,6 +130,7 @@ NorlsAllocator::~NorlsAllocator()
 
 #endif NRLSTRACK
     FreeHeap();
+    ReportToSite();
 }
 
 /*
@@ -329,6 +338,10 @@ void* NorlsAllocator::_AllocNonZero(size_t& sz)
     m_dwAllocThreadId  = 0;
 #endif NRLSTRACK
     
+    m_cbLive += roundSize;
+    m_cbPending += roundSize;
+    m_cPending++;
+
     sz = roundSize;
 #if NRLSTRACK
     VSASSERT(m_dwAllocThreadId == 0," NorlsAlloc: only 1 thread allowed at a time");
@@ -422,6 +435,8 @@ NorlsAllocator::Resize(
                 size_t diff = (pEnd-nextFree);
                 memset(nextFree, 0, diff);
                 nextFree = pEnd;
+                m_cbLive += diff;
+                m_cbPending += diff;
 
                 AssertIfFalse((size_t)nextFree % sizeof(void*) == 0);
                 AssertIfFalse((size_t)limitFree % sizeof(void*) == 0);
@@ -431,6 +446,7 @@ NorlsAllocator::Resize(
         }
         else
         {
+            m_cbLive -= nextFree - ((BYTE*)pv + VBMath::RoundUpAllocSize(cbSizeNew));
             nextFree = (BYTE*)pv + VBMath::RoundUpAllocSize(cbSizeNew);
 
             AssertIfFalse((size_t)nextFree % sizeof(void*) == 0);
@@ -491,6 +507,9 @@ NorlsPage * NorlsAllocator::NewPage(size_t sz)
     // Allocate the new page.
     newPage = (NorlsPage *) m_heapPage.AllocPages(allocSize);
 
+    ReportToSite();
+    m_pSite->AddPages((LONG)(allocSize / pageSize));
+
 #if DEBUG
     // Add buffer overflow detection
     newPage->sentinalStart = DEBUGSENTINAL; 
@@ -503,6 +522,7 @@ NorlsPage * NorlsAllocator::NewPage(size_t sz)
     newPage->next = NULL;
     newPage->firstAvail = (BYTE *)newPage + VBMath::RoundUpAllocSize(sizeof(NorlsPage));
     newPage->limitAvail = ((BYTE *)newPage) + allocSize;
+    newPage->allocatingThreadId = GetCurrentThreadId();
 
     // We should have enough room in the new page!
     VSASSERT(newPage->limitAvail > newPage->firstAvail,"Invalid");
@@ -533,6 +553,7 @@ void NorlsAllocator::Mark(NorlsMark * mark)
     mark->page = pageLast;
     mark->nextFree = nextFree;
     mark->depth = m_depth;
+    mark->cbLiveAtMark = m_cbLive;
 #if NRLSTRACK  
     mark->m_nTotalAllocatedAtMark = m_nTotalAllocated;
 #if NRLSTRACK_GETSTACKS    
@@ -580,6 +601,11 @@ void NorlsAllocator::Free(NorlsMark * mark)
     {
         NorlsPage * page, *nextPage;
 
+        VSASSERT(m_cbLive >= mark->cbLiveAtMark, "Invalid");
+        ReportToSite();
+        InterlockedExchangeAdd64(&m_pSite->cbRewound, (LONGLONG)(m_cbLive - mark->cbLiveAtMark));
+        m_cbLive = mark->cbLiveAtMark;
+
 #ifdef DEBUG
         page = pageList;
         while (page != pageLast)
@@ -596,7 +622,8 @@ void NorlsAllocator::Free(NorlsMark * mark)
         for (page = mark->page->next; page != NULL; page = nextPage)
         {
             nextPage = page->next;
-            m_heapPage.FreePages(entity, page, (BYTE *)page->limitAvail - (BYTE *)page);
+            m_pSite->AddPages(-(LONG)(((BYTE *)page->limitAvail - (BYTE *)page) / PageHeap::pageSize));
+            m_heapPage.FreePages(entity, page, (BYTE *)page->limitAvail - (BYTE *)page, page->allocatingThreadId);
         }
 
         // Reset the last page and location.
@@ -629,11 +656,19 @@ void NorlsAllocator::FreeHeap()
 
     VerifyHeap();
 
+    if (m_cbLive)
+    {
+        ReportToSite();
+        InterlockedExchangeAdd64(&m_pSite->cbRewound, (LONGLONG)m_cbLive);
+        m_cbLive = 0;
+    }
+
     // Free all the pages.
     for (page = pageList; page != NULL; page = nextPage)
     {
         nextPage = page->next;
-        m_heapPage.FreePages(entity, page, (BYTE *)page->limitAvail - (BYTE *)page);
+        m_pSite->AddPages(-(LONG)(((BYTE *)page->limitAvail - (BYTE *)page) / PageHeap::pageSize));
+        m_heapPage.FreePages(entity, page, (BYTE *)page->limitAvail - (BYTE *)page, page->allocatingThreadId);
     }
 
     // Reset the allocator.
@@ -679,6 +714,136 @@ NorlsAllocator::VerifyHeap()
 }
 
 
+/////////////////////////////////////////////////////////////////////////////////
+// NorlsAllocProfiler
+
+// There is one site per NORLSLOC, so a small fixed table is plenty.  It is
+// statically zeroed, which lets allocators be created before or after static
+// construction.  Slots are never reused; once fInUse is set a slot is read
+// without the lock.
+#define NORLS_SITE_TABLE_SIZE 1024      // power of 2.
+
+static NorlsAllocSite g_rgNorlsSites[NORLS_SITE_TABLE_SIZE];
+static NorlsAllocSite g_NorlsOverflowSite;     // catches everything if the table fills.
+static CTinyLock g_NorlsSiteLock;
+
+static bool IsSameNorlsSite(const NorlsAllocSite & site, _In_z_ const WCHAR *szFile, long nLineNo)
+{
+    return site.nLineNo == nLineNo && (site.szFile == szFile || wcscmp(site.szFile, szFile) == 0);
+}
+
+NorlsAllocSite * NorlsAllocProfiler::GetSite(_In_z_ const WCHAR *szFile, long nLineNo)
+{
+    // FNV-1a over the file name, mixed with the line.
+    unsigned long hash = 2166136261UL;
+    for (const WCHAR *pch = szFile; *pch; pch++)
+    {
+        hash = (hash ^ *pch) * 16777619UL;
+    }
+    hash ^= (unsigned long)nLineNo * 2654435761UL;
+
+    unsigned iFirst = hash & (NORLS_SITE_TABLE_SIZE - 1);
+
+    // Most lookups are for sites already in the table.
+    for (unsigned i = iFirst; g_rgNorlsSites[i].fInUse; i = (i + 1) & (NORLS_SITE_TABLE_SIZE - 1))
+    {
+        if (IsSameNorlsSite(g_rgNorlsSites[i], szFile, nLineNo))
+            return &g_rgNorlsSites[i];
+        if (((i + 1) & (NORLS_SITE_TABLE_SIZE - 1)) == iFirst)
+            return &g_NorlsOverflowSite;
+    }
+
+    CTinyGate gate(&g_NorlsSiteLock);
+
+    unsigned i = iFirst;
+    do
+    {
+        NorlsAllocSite & site = g_rgNorlsSites[i];
+        if (!site.fInUse)
+        {
+            site.szFile = szFile;
+            site.nLineNo = nLineNo;
+            InterlockedExchange(&site.fInUse, TRUE);     // publish after the key is written.
+            return &site;
+        }
+        if (IsSameNorlsSite(site, szFile, nLineNo))
+        {
+            return &site;
+        }
+        i = (i + 1) & (NORLS_SITE_TABLE_SIZE - 1);
+    } while (i != iFirst);
+
+    return &g_NorlsOverflowSite;
+}
+
+void NorlsAllocProfiler::WriteCsv(FILE * file)
+{
+    fwprintf(file, L"file,line,allocators,bytes,allocations,rewound_bytes,pages,peak_pages\n");
+
+    for (unsigned i = 0; i < NORLS_SITE_TABLE_SIZE; i++)
+    {
+        const NorlsAllocSite & site = g_rgNorlsSites[i];
+        if (site.fInUse)
+        {
+            fwprintf(file, L"%s,%d,%d,%I64d,%I64d,%I64d,%d,%d\n",
+                     PathFindFileName(site.szFile), site.nLineNo, site.cAllocators,
+                     site.cbAllocated, site.cAllocations, site.cbRewound,
+                     site.cPagesCur, site.cPagesPeak);
+        }
+    }
+}
+
+void NorlsAllocProfiler::WriteJson(FILE * file)
+{
+    fwprintf(file, L"{\n  \"pageSize\": %d,\n  \"sites\": [", (int)PageHeap::pageSize);
+
+    bool fFirst = true;
+    for (unsigned i = 0; i < NORLS_SITE_TABLE_SIZE; i++)
+    {
+        const NorlsAllocSite & site = g_rgNorlsSites[i];
+        if (site.fInUse)
+        {
+            // File names come from __FILE__ with the directory stripped, so they
+            // need no escaping.
+            fwprintf(file, L"%s\n    { \"file\": \"%s\", \"line\": %d, \"allocators\": %d, "
+                           L"\"bytes\": %I64d, \"allocations\": %I64d, \"rewoundBytes\": %I64d, "
+                           L"\"pages\": %d, \"peakPages\": %d }",
+                     fFirst ? L"" : L",",
+                     PathFindFileName(site.szFile), site.nLineNo, site.cAllocators,
+                     site.cbAllocated, site.cAllocations, site.cbRewound,
+                     site.cPagesCur, site.cPagesPeak);
+            fFirst = false;
+        }
+    }
+
+    fwprintf(file, L"\n  ]\n}\n");
+}
+
+void NorlsAllocProfiler::WriteReport(_In_z_ PCWSTR fname)
+{
+    FILE* f = NULL;
+    if (!_wfopen_s(&f, fname, L"w"))
+    {
+        if (!_wcsicmp(PathFindExtension(fname), L".json"))
+            WriteJson(f);
+        else
+            WriteCsv(f);
+        fclose(f);
+    }
+}
+
+void NorlsAllocProfiler::WriteReportIfRequested()
+{
+    const LPCWSTR wszEnvironmentVar = L"VBC_NORLS_PROFILE";
+    WCHAR wszPath[MAX_PATH];
+
+    DWORD cch = GetEnvironmentVariableW(wszEnvironmentVar, wszPath, _countof(wszPath));
+    if (cch > 0 && cch < _countof(wszPath))
+    {
+        WriteReport(wszPath);
+    }
+}
+
 #if NRLSTRACK
 
 
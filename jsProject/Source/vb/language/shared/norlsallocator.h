@@ -84,6 +84,7 @@ struct NorlsPage
     NorlsPage * next;      // next page in use.
     BYTE * firstAvail;  // first available byte for allocation.
     BYTE * limitAvail;  // limit for allocation.
+    DWORD allocatingThreadId;   // thread that took the page from the PageHeap.
 
 #if DEBUG
     size_t sentinalEnd; // Buffer overflow check
@@ -99,6 +100,8 @@ private:
     BYTE * nextFree;    // first free location within the page.
     unsigned depth;
 
+    size_t cbLiveAtMark;    // allocator's live bytes when the mark was taken.
+
 #if NRLSTRACK  
     long m_nTotalAllocatedAtMark;
 #if NRLSTRACK_GETSTACKS    
@@ -108,12 +111,56 @@ private:
 
 };
 
-
-#if NRLSTRACK  
+// Allocators are tagged with the place they were created in all builds, so that
+// NorlsAllocProfiler can attribute memory to allocation sites.
 #define NORLSLOC __WFILE__, __LINE__
-#else
-#define NORLSLOC -1
-#endif
+
+// Counters for all the NorlsAllocators created at one NORLSLOC.  Allocators
+// accumulate bytes and allocation counts locally and fold them in here when they
+// take a new page or are rewound, so the counters lag by at most a page per
+// live allocator.
+struct NorlsAllocSite
+{
+    const WCHAR * szFile;
+    long nLineNo;
+    volatile LONG fInUse;               // set once szFile and nLineNo are valid.
+
+    volatile LONG cAllocators;          // allocators created at this site.
+    volatile LONGLONG cbAllocated;      // bytes handed out, after rounding.
+    volatile LONGLONG cAllocations;
+    volatile LONGLONG cbRewound;        // bytes released by Free(NorlsMark*) and FreeHeap.
+    volatile LONG cPagesCur;            // system pages held by this site's allocators.
+    volatile LONG cPagesPeak;
+
+    void AddPages(LONG cPages)
+    {
+        LONG cCur = InterlockedExchangeAdd(&cPagesCur, cPages) + cPages;
+        LONG cPeak = cPagesPeak;
+        while (cCur > cPeak)
+        {
+            LONG cOld = InterlockedCompareExchange(&cPagesPeak, cCur, cPeak);
+            if (cOld == cPeak)
+                break;
+            cPeak = cOld;
+        }
+    }
+};
+
+// Always-on registry of NorlsAllocSites.  Call WriteReportIfRequested at the end
+// of a compilation to dump the counters to the file named by VBC_NORLS_PROFILE:
+// JSON if the name ends in ".json", CSV otherwise.
+class NorlsAllocProfiler
+{
+public:
+    static NorlsAllocSite * GetSite(_In_z_ const WCHAR *szFile, long nLineNo);
+
+    static void WriteReport(_In_z_ PCWSTR fname);
+    static void WriteReportIfRequested();
+
+private:
+    static void WriteCsv(FILE * file);
+    static void WriteJson(FILE * file);
+};
 
 class NorlsAllocator
 {
@@ -156,20 +203,12 @@ public:
 
 
     NorlsAllocator(
-#if NRLSTRACK
      _In_ WCHAR *szFile, _In_ long nLineNo
-#else
-    _In_ int nUnused 
-#endif NRLSTRACK
     );
     ~NorlsAllocator();
 
     NorlsAllocator(
-#if NRLSTRACK
      _In_ WCHAR *szFile, _In_ long nLineNo,
-#else
-    _In_ int nUnused,
-#endif NRLSTRACK
     _In_ PageHeap& heapToAllocateFrom
     );
 
@@ -284,7 +323,8 @@ private:
     NorlsAllocator(const NorlsAllocator&);
     NorlsAllocator& operator=(const NorlsAllocator&);
 
-    void Init(ProtectedEntityFlagsEnum entity);
+    void Init(ProtectedEntityFlagsEnum entity, _In_z_ WCHAR *szFile, long nLineNo);
+    void ReportToSite();
     void VerifyHeapEntity()
     {
         VSASSERT(entity, "Heap entity must be set before manipulating heap writeability");
@@ -331,6 +371,12 @@ private:
     void AllocNewPage(size_t sz);
     NorlsPage * NewPage(size_t sz);
 
+    // Allocation profiling; see NorlsAllocSite.
+    NorlsAllocSite * m_pSite;
+    size_t m_cbLive;                // bytes allocated since the last FreeHeap, less those rewound.
+    size_t m_cbPending;             // bytes allocated and not yet reported to m_pSite.
+    size_t m_cPending;              // allocations not yet reported to m_pSite.
+
     ProtectedEntityFlagsEnum entity;
     bool allowReadOnlyDirectives;
     bool anyPageMarkedReadOnly;
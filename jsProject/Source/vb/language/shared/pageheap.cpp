@@ -24,6 +24,38 @@
 size_t PageHeap::pageSize;         // The system page size.
 int PageHeap::pageShift;           // log2 of the page size
 bool PageHeap::reliableCommit;     // MEM_COMMIT reliable?
+int PageHeap::pagesPerArena;       // Pages in a regular or single page arena.
+size_t PageHeap::largePageSize;    // Large page size, or 0 if large pages aren't used.
+
+static bool AreLargePageArenasRequested()
+{
+    const LPCWSTR wszEnvironmentVar = L"VBC_LARGE_PAGE_ARENAS";
+    return GetEnvironmentVariableW(wszEnvironmentVar, NULL, 0) != 0;
+}
+
+/*
+* Large pages can only be allocated by a process holding SeLockMemoryPrivilege,
+* and the privilege must be enabled in the token before the first allocation.
+*/
+static bool EnableLockMemoryPrivilege()
+{
+    HANDLE hToken;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+    {
+        return false;
+    }
+
+    TOKEN_PRIVILEGES tp;
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    bool ok = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) &&
+              AdjustTokenPrivileges(hToken, FALSE, &tp, 0, NULL, NULL) &&
+              GetLastError() == ERROR_SUCCESS;      // ERROR_NOT_ALL_ASSIGNED if we don't hold it.
+
+    CloseHandle(hToken);
+    return ok;
+}
 
 size_t GetSystemPageSize()
 {
@@ -65,6 +97,24 @@ void PageHeap::StaticInit()
         BOOL ok = GetVersionEx(&osvi);
         VSASSERT(ok, "Invalid");
         reliableCommit = ok && osvi.dwMajorVersion >= 5;
+
+        PageHeap::pagesPerArena = PAGES_PER_ARENA;
+
+        // Large pages can't be protected a system page at a time, so they are
+        // only used when no memory protection is enabled.  The arena geometry
+        // is settled here, before the first arena is created, and never changes.
+        if (AreLargePageArenasRequested())
+        {
+            size_t cbLargePage = GetLargePageMinimum();
+            if (cbLargePage != 0 &&
+                (MAX_PAGES_PER_ARENA * PageHeap::pageSize) % cbLargePage == 0 &&
+                PageProtect::StaticWhatIsProtected() == ProtectedEntityFlags::Nothing &&
+                EnableLockMemoryPrivilege())
+            {
+                PageHeap::largePageSize = cbLargePage;
+                PageHeap::pagesPerArena = MAX_PAGES_PER_ARENA;
+            }
+        }
     }
 }
 
@@ -77,7 +127,7 @@ void PageHeap::PageArena::FreeAddressSpace()
 
 bool PageHeap::PageArena::HasUsedPages() const
 {
-    for (unsigned int i = 0; i < PAGES_PER_ARENA / BITS_DWORD; i++)
+    for (int i = 0; i < pagesPerArena / BITS_DWORD; i++)
     {
         if (used[i])
             return true;
@@ -95,10 +145,19 @@ arenaList(NULL),
 arenaLast(NULL),
 singlePageArenaList(NULL),
 singlePageArenaLast(NULL),
-whatIsProtected(ProtectedEntityFlags::Nothing)
+whatIsProtected(ProtectedEntityFlags::Nothing),
+m_cCrossThreadFrees(0),
+m_cMagazineRefills(0),
+m_cMagazineFlushes(0),
+m_cLargePageArenas(0)
 {
     CTinyGate gate (&lock ); // Acquire the lock
     StaticInit();
+
+    for (unsigned i = 0; i < PAGE_MAGAZINE_COUNT; i++)
+    {
+        m_magazines[i].count = 0;
+    }
 }
 
 /*
@@ -106,7 +165,7 @@ whatIsProtected(ProtectedEntityFlags::Nothing)
 */
 PageHeap::~PageHeap()
 {
-    CTinyGate gate (&lock ); // Acquire the lock
+    // FreeAllPages acquires the lock itself, after emptying the magazines.
     FreeAllPages();
 }
 
@@ -255,7 +314,7 @@ void* PageHeap::PageArena::AllocPages(unsigned int cPages, PageHeap& parent)
         0;
 #endif
 
-    int iPage = LookForPages((unsigned int)cPages, iWhereToBeginPageSearch, PAGES_PER_ARENA - 1);
+    int iPage = LookForPages((unsigned int)cPages, iWhereToBeginPageSearch, pagesPerArena - 1);
 
 #ifdef SPREAD_ALLOCATIONS
     if (-1 == iPage)
@@ -265,7 +324,7 @@ void* PageHeap::PageArena::AllocPages(unsigned int cPages, PageHeap& parent)
         //succeed. Therefore look from beginning to N + cPages - 1 so as not to
         //leave a potential hole of cPages - 1.
         iPage = LookForPages((unsigned int)cPages, 0, 
-            min(m_iStartNextAlloc + (unsigned int)cPages - 1, PAGES_PER_ARENA - 1));
+            min(m_iStartNextAlloc + (unsigned int)cPages - 1, pagesPerArena - 1));
     }
 #endif
 
@@ -295,6 +354,13 @@ void* PageHeap::PageArena::AllocPages(unsigned int cPages, PageHeap& parent)
 
 void * PageHeap::AllocPages(size_t sz)
 {
+    // Single page requests are >99% of the traffic; serve them from this
+    // thread's magazine without taking the heap lock.
+    if (sz == pageSize && UseMagazines())
+    {
+        return MagazineAlloc();
+    }
+
     CTinyGate gate (&lock ); // Acquire the lock
 
     VSASSERT(sz % pageSize == 0 && sz != 0, "Invalid");     // must be page size multiple.
@@ -336,7 +402,7 @@ void * PageHeap::AllocPages(size_t sz)
 
     // No arenas have enough free space. Create a new arena and allocate
     // at the beginning of that arena.
-    arena = CreateArena(Normal, PAGES_PER_ARENA * pageSize);
+    arena = CreateArena(Normal, pagesPerArena * pageSize);
 
 
     p = arena->AllocPages((unsigned int)cPages, *this);
@@ -372,6 +438,12 @@ void PageHeap::RemoveArena (const T* goingAway, T*& containingArenaList, T*& con
 
 void PageHeap::FreeUnusedArenas()
 {
+    // Pages parked in the magazines keep their arenas alive; return them first.
+    if (!lock.LockedByMe())
+    {
+        FlushAllMagazines();
+    }
+
     CTinyGate gate (&lock); 
 
     PageArena* nextArena = NULL;
@@ -388,6 +460,8 @@ void PageHeap::FreeUnusedArenas()
             //unlink from list.
             RemoveArena(arena, arenaList, arenaLast);
             size_t addressSpace = arena->GetAddressSpaceSize();
+            if (arena->largePages)
+                m_cLargePageArenas--;
             arena->FreeAddressSpace();
             m_pageCurReserve -= addressSpace / pageSize;
 
@@ -402,12 +476,14 @@ void PageHeap::FreeUnusedArenas()
         SinglePageArena* arena = singlePageArenasWithFreePages.front();
         singlePageArenasWithFreePages.pop();
 
-        if (arena->NumberOfFreePagesAvailable() == PAGES_PER_ARENA) // all the pages are free
+        if (arena->NumberOfFreePagesAvailable() == pagesPerArena) // all the pages are free
         {
             // Unlink from list and delete the arena
             addressToSinglePageArenaMap.erase(arena->pages);
             RemoveArena(arena, singlePageArenaList, singlePageArenaLast);
             size_t addressSpace = arena->GetAddressSpaceSize();
+            if (arena->largePages)
+                m_cLargePageArenas--;
             arena->FreeAddressSpace();                       // sets arena->pages = NULL
             m_pageCurReserve -= addressSpace / pageSize;
 
@@ -426,6 +502,12 @@ void PageHeap::FreeUnusedArenas()
 */
 void PageHeap::FreePages(ProtectedEntityFlagsEnum entity, _Post_invalid_ void * p, size_t sz)
 {
+    if (sz == pageSize && UseMagazines())
+    {
+        MagazineFree(entity, p);
+        return;
+    }
+
     CTinyGate gate (&lock ); // Acquire the lock
 
     VSASSERT(sz % pageSize == 0 && sz != 0, "Invalid");     // must be page size multiple.
@@ -453,6 +535,16 @@ void PageHeap::FreePages(ProtectedEntityFlagsEnum entity, _Post_invalid_ void *
     FreePagesHelper(entity, arena, p, sz);
 }
 
+void PageHeap::FreePages(ProtectedEntityFlagsEnum entity, _Post_invalid_ void * p, size_t sz, DWORD dwAllocatingThreadId)
+{
+    if (dwAllocatingThreadId != GetCurrentThreadId())
+    {
+        InterlockedIncrement(&m_cCrossThreadFrees);
+    }
+
+    FreePages(entity, p, sz);
+}
+
 void PageHeap::FreePagesHelper(ProtectedEntityFlagsEnum entity, PageArena * arena, void * p, size_t sz)
 {
     size_t cPages = (sz >> pageShift);
@@ -476,6 +568,8 @@ void PageHeap::FreePagesHelper(ProtectedEntityFlagsEnum entity, PageArena * aren
     }
 
 #ifdef DECOMMIT_ON_FREE
+    // Large pages can't be decommitted individually; they go with the arena.
+    if (!arena->largePages)
     {
         iPage = initialPageIndex;
         BOOL b = VirtualFree((BYTE *)arena->pages + (iPage << pageShift), sz, MEM_DECOMMIT);
@@ -600,7 +694,7 @@ void* PageHeap::SinglePageAlloc()
 
     // No arenas have enough free space. Create a new arena and allocate
     // at the beginning of that arena.
-    arena = (SinglePageArena*) CreateArena(SinglePageAllocation, PAGES_PER_ARENA * pageSize);
+    arena = (SinglePageArena*) CreateArena(SinglePageAllocation, pagesPerArena * pageSize);
 
     int iPage = arena->freePageStack[arena->topOfFreePageStack];
     arena->topOfFreePageStack--;
@@ -621,7 +715,7 @@ void PageHeap::SinglePageFree(ProtectedEntityFlagsEnum entity, _Post_invalid_ vo
     // p belongs to the closest arena whose first page is <= p, and upper_bound returns the first arena whose
     // page is strictly greater than p.
     SinglePageArena* arena = (--addressToSinglePageArenaMap.upper_bound(p))->second;
-    VSASSERT(arena && arena->size == PAGES_PER_ARENA * pageSize && arena->OwnsPage(p), "Invalid");
+    VSASSERT(arena && arena->size == pagesPerArena * pageSize && arena->OwnsPage(p), "Invalid");
 
     // Mark the page as freed
     FreePagesHelper(entity, arena, p, pageSize);
@@ -629,7 +723,7 @@ void PageHeap::SinglePageFree(ProtectedEntityFlagsEnum entity, _Post_invalid_ vo
     // push page back on to our free page stack
     int iPage = (int) ((BYTE *)p - (BYTE *)arena->pages) >> pageShift;
     ++arena->topOfFreePageStack;
-    VSASSERT(arena->topOfFreePageStack < PAGES_PER_ARENA, "too many pages available");
+    VSASSERT(arena->topOfFreePageStack < pagesPerArena, "too many pages available");
     arena->freePageStack[arena->topOfFreePageStack] = iPage;
 
     // add this arena back to our free list if we were full, but now have a single free page
@@ -639,6 +733,123 @@ void PageHeap::SinglePageFree(ProtectedEntityFlagsEnum entity, _Post_invalid_ vo
     }
 }
 
+/////////////////////////////////////////////////////////////////////////////////
+// Per-thread page magazines.
+
+bool PageHeap::UseMagazines()
+{
+    // When unused memory is protected every free must reach FreePagesHelper
+    // so that the page is made inaccessible right away.
+    return !PageProtect::IsEntityProtected(ProtectedEntityFlags::UnusedMemory);
+}
+
+PageHeap::PageMagazine& PageHeap::GetMagazine()
+{
+    // Thread ids are multiples of 4.
+    return m_magazines[(GetCurrentThreadId() >> 2) & (PAGE_MAGAZINE_COUNT - 1)];
+}
+
+void* PageHeap::MagazineAlloc()
+{
+    PageMagazine& magazine = GetMagazine();
+    CTinyGate magazineGate (&magazine.lock);
+
+    if (magazine.count == 0)
+    {
+        // Refill a batch of pages under a single acquisition of the heap lock.
+        CTinyGate gate (&lock);
+
+        m_cMagazineRefills++;
+
+        while (magazine.count < PAGE_MAGAZINE_BATCH)
+        {
+            void* pPage = SinglePageAlloc();
+
+            // Fail like the other allocation paths rather than hand out a NULL
+            // page later.  The pages already in the magazine stay usable.
+            if (!pPage)
+            {
+                VbThrow(E_OUTOFMEMORY);
+            }
+
+            magazine.pages[magazine.count] = pPage;
+            magazine.count++;
+
+            m_pageCurUse++;
+            if (m_pageCurUse > m_pageMaxUse)
+                m_pageMaxUse = m_pageCurUse;
+        }
+    }
+
+    magazine.count--;
+    void* p = magazine.pages[magazine.count];
+
+#ifdef DEBUG
+    // Make sure they aren't zero filled.
+    memset(p, 0xCC, pageSize);
+#endif //DEBUG
+
+    return p;
+}
+
+void PageHeap::MagazineFree(ProtectedEntityFlagsEnum entity, _Post_invalid_ void* p)
+{
+    PageMagazine& magazine = GetMagazine();
+    CTinyGate magazineGate (&magazine.lock);
+
+    // Same treatment FreePagesHelper gives a page when unused memory is not protected.
+    PageProtect::AllowWrite(entity, p, pageSize);
+
+#ifdef DEBUG
+    // Fill pages with junk to indicated unused.
+    memset(p, 0xAE, pageSize);
+#endif //DEBUG
+
+    if (magazine.count == PAGE_MAGAZINE_CAPACITY)
+    {
+        FlushMagazine(magazine, PAGE_MAGAZINE_CAPACITY - PAGE_MAGAZINE_BATCH);
+    }
+
+    magazine.pages[magazine.count] = p;
+    magazine.count++;
+}
+
+/*
+* Return all but cPagesToKeep pages in the magazine to their arenas.  The
+* caller must hold the magazine lock.
+*/
+void PageHeap::FlushMagazine(PageMagazine& magazine, unsigned cPagesToKeep)
+{
+    VSASSERT(magazine.lock.LockedByMe(), "Magazine must be locked");
+
+    if (magazine.count <= cPagesToKeep)
+    {
+        return;
+    }
+
+    CTinyGate gate (&lock);
+
+    m_cMagazineFlushes++;
+
+    while (magazine.count > cPagesToKeep)
+    {
+        magazine.count--;
+        m_pageCurUse--;
+        SinglePageFree(ProtectedEntityFlags::Nothing, magazine.pages[magazine.count]);
+    }
+}
+
+void PageHeap::FlushAllMagazines()
+{
+    VSASSERT(!lock.LockedByMe(), "Magazine locks must be taken before the heap lock");
+
+    for (unsigned i = 0; i < PAGE_MAGAZINE_COUNT; i++)
+    {
+        CTinyGate magazineGate (&m_magazines[i].lock);
+        FlushMagazine(m_magazines[i], 0);
+    }
+}
+
 void FreeArenaList(PageHeap::PageArena* list, bool checkLeaks)
 {
     PageHeap::PageArena * arena, *nextArena;
@@ -652,7 +863,7 @@ void FreeArenaList(PageHeap::PageArena* list, bool checkLeaks)
         {
             VSASSERT(arena->type != PageHeap::LargeAllocation, "Invalid");        // Large allocation should have been freed by now.
 
-            for (int dwIndex = 0; dwIndex < PAGES_PER_ARENA / BITS_DWORD; ++dwIndex)
+            for (int dwIndex = 0; dwIndex < PageHeap::pagesPerArena / BITS_DWORD; ++dwIndex)
             {
                 VSASSERT(arena->used[dwIndex] == 0, "Invalid");  // All pages in this arena should be free.
             }
@@ -674,12 +885,16 @@ void FreeArenaList(PageHeap::PageArena* list, bool checkLeaks)
 */
 void PageHeap::FreeAllPages(bool checkLeaks)
 {
+    // Magazine pages are still marked used in their arenas.
+    FlushAllMagazines();
+
     CTinyGate gate (&lock ); // Acquire the lock
 
     FreeArenaList(arenaList, checkLeaks);
     FreeArenaList(singlePageArenaList, checkLeaks);
 
     m_pageCurUse = m_pageCurReserve = 0;
+    m_cLargePageArenas = 0;
     arenaList = arenaLast = NULL;
     singlePageArenaList = singlePageArenaLast = NULL;
 
@@ -696,10 +911,11 @@ bool PageHeap::DecommitUnusedPagesFromArenaList(PageArena* list)
 
     for (arena = list; arena != NULL; arena = arena->nextArena)
     {
-        if (arena->type == LargeAllocation)
+        // Large pages can't be decommitted individually; they go with the arena.
+        if (arena->type == LargeAllocation || arena->largePages)
             continue;
 
-        for (int dwIndex = 0; dwIndex < PAGES_PER_ARENA / BITS_DWORD; ++dwIndex)
+        for (int dwIndex = 0; dwIndex < pagesPerArena / BITS_DWORD; ++dwIndex)
         {
             // Can we decommit 32 pages at once with one OS call?
             if (arena->used[dwIndex] == 0 && arena->committed[dwIndex] != 0)
@@ -742,7 +958,7 @@ bool PageHeap::DecommitUnusedPagesFromArenaList(PageArena* list)
 
 #ifdef DEBUG
         // At this point, the only committed pages in this arena should be in use.
-        for (int dwIndex = 0; dwIndex < PAGES_PER_ARENA / BITS_DWORD; ++dwIndex)
+        for (int dwIndex = 0; dwIndex < pagesPerArena / BITS_DWORD; ++dwIndex)
         {
             VSASSERT(arena->used[dwIndex] == arena->committed[dwIndex], "Invalid");
         }
@@ -757,6 +973,14 @@ bool PageHeap::DecommitUnusedPagesFromArenaList(PageArena* list)
 */
 bool PageHeap::DecommitUnusedPages()
 {
+    // Pages in the magazines are committed but unused; give them back so they can
+    // be decommitted.  Skip this when called from within the heap (i.e. from
+    // AllocPagesHelper) since the magazine locks must be taken first.
+    if (!lock.LockedByMe())
+    {
+        FlushAllMagazines();
+    }
+
     CTinyGate gate (&lock ); // Acquire the lock
 
     bool anyDecommitted = DecommitUnusedPagesFromArenaList(arenaList);
@@ -769,7 +993,7 @@ PageHeap::SinglePageArena::SinglePageArena()
 {
     // push the arena's list of pages onto the free page stack
     topOfFreePageStack = -1;
-    for(int i = 0; i < PAGES_PER_ARENA; i++)
+    for(int i = 0; i < pagesPerArena; i++)
     {
         ++topOfFreePageStack;
         freePageStack[topOfFreePageStack] = i;
@@ -829,12 +1053,29 @@ PageHeap::PageArena * PageHeap::CreateArena(PageArenaType type, size_t sz)
         }
     }
 
-    newArena->pages = VirtualAlloc(0, sz, type == LargeAllocation ? MEM_COMMIT : MEM_RESERVE, PAGE_READWRITE);
+    if (type != LargeAllocation && largePageSize)
+    {
+        newArena->pages = ReserveHugePageArena(sz, &newArena->largePages);
+    }
+    else
+    {
+        newArena->pages = VirtualAlloc(0, sz, type == LargeAllocation ? MEM_COMMIT : MEM_RESERVE, PAGE_READWRITE);
+    }
     if (!newArena->pages)
     {
         VbThrow(GetLastHResultError());
     }
 
+    if (newArena->largePages)
+    {
+        // Every page is committed already, so AllocPagesHelper never commits.
+        for (int dwIndex = 0; dwIndex < pagesPerArena / BITS_DWORD; ++dwIndex)
+        {
+            newArena->committed[dwIndex] = ~0u;
+        }
+        m_cLargePageArenas++;
+    }
+
     if (newSinglePageArena)
     {
         // also add the new SinglePageArena to our indexing data structures
@@ -856,6 +1097,58 @@ PageHeap::PageArena * PageHeap::CreateArena(PageArenaType type, size_t sz)
     return newArena;
 }
 
+/*
+* Reserve address space for a regular or single page arena on a
+* HUGE_PAGE_ARENA_ALIGNMENT boundary.  If large pages are available the arena
+* is committed in full right away, since large pages can't be committed or
+* decommitted piecemeal.  Otherwise it's reserved like any other arena, and
+* pages are committed on demand.  Returns NULL on failure.
+*/
+void* PageHeap::ReserveHugePageArena(size_t sz, _Out_ bool* pfLargePages)
+{
+    VSASSERT(sz % HUGE_PAGE_ARENA_ALIGNMENT == 0, "Invalid");
+
+    *pfLargePages = false;
+
+    if (largePageSize)
+    {
+        // Large page allocations are always aligned on the large page size.
+        void* p = VirtualAlloc(0, sz, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p)
+        {
+            *pfLargePages = true;
+            return p;
+        }
+
+        // No contiguous physical memory; fall back to regular pages.
+    }
+
+    // Reserve more than we need to find an aligned address, then release it and
+    // reserve exactly at that address.  Another thread can take the range in
+    // between, so retry a few times before settling for an unaligned arena.
+    for (int iTry = 0; iTry < 4; iTry++)
+    {
+        BYTE* pSpan = (BYTE*)VirtualAlloc(0, sz + HUGE_PAGE_ARENA_ALIGNMENT, MEM_RESERVE, PAGE_READWRITE);
+        if (!pSpan)
+        {
+            break;
+        }
+
+        BYTE* pAligned = (BYTE*)(((UINT_PTR)pSpan + HUGE_PAGE_ARENA_ALIGNMENT - 1) & ~(UINT_PTR)(HUGE_PAGE_ARENA_ALIGNMENT - 1));
+
+        BOOL b = VirtualFree(pSpan, 0, MEM_RELEASE);
+        VSASSERT(b, "Invalid");
+
+        void* p = VirtualAlloc(pAligned, sz, MEM_RESERVE, PAGE_READWRITE);
+        if (p)
+        {
+            return p;
+        }
+    }
+
+    return VirtualAlloc(0, sz, MEM_RESERVE, PAGE_READWRITE);
+}
+
 /*
 * Find an arena that contains a particular pointer.
 */
@@ -16,9 +16,22 @@
 #define SPREAD_ALLOCATIONS  // allocate after the previous allocation instead of looking from the
                             // beginning of each arena
 
+// Regular and single page arenas hold PageHeap::pagesPerArena pages, which is
+// PAGES_PER_ARENA unless huge page arenas are turned on at startup by setting
+// the VBC_LARGE_PAGE_ARENAS environment variable.  Then, if the process may use
+// large pages (SeLockMemoryPrivilege) and no memory protection is enabled, the
+// arenas hold MAX_PAGES_PER_ARENA pages and are committed up front with large
+// pages, which cuts TLB misses when walking big symbol tables at the cost of
+// keeping whole arenas committed.
 #define PAGES_PER_ARENA 128              // 4k system page size => 128*4k = 512KB per arena
+#define MAX_PAGES_PER_ARENA 512          // 4k system page size => 512*4k = 2MB per arena
+#define HUGE_PAGE_ARENA_ALIGNMENT (2 * 1024 * 1024)
 #define BIGALLOC_SIZE   (128 * 1024)    // more than this alloc (128KB) is not done from an arena.
 
+#define PAGE_MAGAZINE_COUNT     16      // per-thread page caches per heap; a power of 2.
+#define PAGE_MAGAZINE_CAPACITY  16      // free single pages a cache can hold.
+#define PAGE_MAGAZINE_BATCH     (PAGE_MAGAZINE_CAPACITY / 2)    // pages moved to or from the arenas at once.
+
 #define DWORD_BIT_SHIFT 5        // log2 of bits in a DWORD.
 #define BITS_DWORD      (1 << DWORD_BIT_SHIFT)
 #define DWORD_BIT_MASK  (BITS_DWORD - 1)
@@ -44,8 +57,9 @@ public:
         void* pages;           // the pages in the arena.
         size_t size;            // size of the arena.
         PageArenaType type;        // large allocs and single page allocs have special cased codepaths
-        DWORD used[PAGES_PER_ARENA / BITS_DWORD];        // bit map of in-use pages in this arena.
-        DWORD committed[PAGES_PER_ARENA / BITS_DWORD];   // bit map of committed pages in this arena.
+        bool largePages;           // committed in full with large pages; never decommitted.
+        DWORD used[MAX_PAGES_PER_ARENA / BITS_DWORD];        // bit map of in-use pages in this arena.
+        DWORD committed[MAX_PAGES_PER_ARENA / BITS_DWORD];   // bit map of committed pages in this arena.
 
 
         bool OwnsPage(const void* p) const
@@ -101,29 +115,29 @@ public:
 
         int LookForPages(unsigned int cPages, int indexPageBegin, int indexLastValidPage);
 
-        void SetPage(_Out_cap_(PAGES_PER_ARENA >> DWORD_BIT_SHIFT) DWORD bitvector[], unsigned index)
+        void SetPage(_Out_cap_(MAX_PAGES_PER_ARENA >> DWORD_BIT_SHIFT) DWORD bitvector[], unsigned index)
         {
-            VSASSERT(index < PAGES_PER_ARENA, "Invalid");
+            VSASSERT(index < (unsigned)pagesPerArena, "Invalid");
             bitvector[index >> DWORD_BIT_SHIFT] |= (1 << (index & DWORD_BIT_MASK));
         }
 
         bool TestPage(DWORD const bitvector[], unsigned index) const
         {
-            VSASSERT(index < PAGES_PER_ARENA, "Invalid");
+            VSASSERT(index < (unsigned)pagesPerArena, "Invalid");
             return bitvector[index >> DWORD_BIT_SHIFT] & (1 << (index & DWORD_BIT_MASK));
         }
 
-        void ClearPage(_Out_cap_(PAGES_PER_ARENA >> DWORD_BIT_SHIFT) DWORD bitvector[], unsigned index) 
+        void ClearPage(_Out_cap_(MAX_PAGES_PER_ARENA >> DWORD_BIT_SHIFT) DWORD bitvector[], unsigned index) 
         {
-            VSASSERT(index < PAGES_PER_ARENA, "Invalid");
+            VSASSERT(index < (unsigned)pagesPerArena, "Invalid");
             bitvector[index >> DWORD_BIT_SHIFT] &= ~(1 << (index & DWORD_BIT_MASK));
         }
     };
 
     struct SinglePageArena : public PageArena
     {
-        int freePageStack[PAGES_PER_ARENA]; // stack of free pages available in singlePageAlloc case
-        int topOfFreePageStack;	            // -1 when there are no free pages, will initially be PAGES_PER_ARENA -1
+        int freePageStack[MAX_PAGES_PER_ARENA]; // stack of free pages available in singlePageAlloc case
+        int topOfFreePageStack;	            // -1 when there are no free pages, will initially be pagesPerArena -1
 
         SinglePageArena();
 
@@ -140,6 +154,8 @@ public:
 
     void* AllocPages( _In_ size_t sz);
     void FreePages(ProtectedEntityFlagsEnum entity, _Post_invalid_ void* p, size_t sz);
+    // As above, noting a cross-thread free if dwAllocatingThreadId is not the current thread.
+    void FreePages(ProtectedEntityFlagsEnum entity, _Post_invalid_ void* p, size_t sz, DWORD dwAllocatingThreadId);
     void FreeAllPages(bool checkLeaks = true);
 
     // When previously committed pages are freed, they are merely marked
@@ -153,6 +169,7 @@ public:
     void ShrinkUnusedResources();
 
     static size_t pageSize;         // The system page size.
+    static int pagesPerArena;       // Pages in a regular or single page arena; fixed by StaticInit.
 
     unsigned GetCurrentUseSize() const
     {
@@ -171,12 +188,31 @@ public:
         return (unsigned)(m_pageMaxReserve * pageSize);
     }
 
+    // Page magazine statistics.
+    unsigned GetCrossThreadFreeCount() const
+    {
+        return (unsigned)m_cCrossThreadFrees;
+    }
+    unsigned GetMagazineRefillCount() const
+    {
+        return m_cMagazineRefills;
+    }
+    unsigned GetMagazineFlushCount() const
+    {
+        return m_cMagazineFlushes;
+    }
+    unsigned GetLargePageArenaCount() const
+    {
+        return m_cLargePageArenas;
+    }
+
     PageArena* FindArena(const void * p);
 
 private:
     CTinyLock lock;             // This is the lock mechanism for thread safety.
 
     PageArena* CreateArena(PageArenaType type, size_t sz);
+    static void* ReserveHugePageArena(size_t sz, _Out_ bool* pfLargePages);
 
     template <typename T>
     void RemoveArena(const T* goingAway, T*& containingArenaList, T*& containingArenaListLast);
@@ -192,6 +228,33 @@ private:
     void* SinglePageAlloc();
     void SinglePageFree(ProtectedEntityFlagsEnum entity, _Post_invalid_ void* p);
 
+    // Per-thread caches of free single pages in front of the single page arenas.
+    // Threads map to a magazine by thread id, so as long as there are fewer busy
+    // threads than magazines each one effectively has its own.  Single page
+    // allocations and frees only take the magazine's lock; pages move between a
+    // magazine and the arenas PAGE_MAGAZINE_BATCH at a time under one acquisition
+    // of the heap lock.  Pages held in a magazine count as in use.
+    //
+    // Lock order: a magazine lock, then the heap lock.
+    struct PageMagazine
+    {
+        CTinyLock lock;
+        unsigned count;
+        void* pages[PAGE_MAGAZINE_CAPACITY];
+    };
+
+    static bool UseMagazines();
+    PageMagazine& GetMagazine();
+    void* MagazineAlloc();
+    void MagazineFree(ProtectedEntityFlagsEnum entity, _Post_invalid_ void* p);
+    void FlushMagazine(PageMagazine& magazine, unsigned cPagesToKeep);
+    void FlushAllMagazines();
+
+    PageMagazine m_magazines[PAGE_MAGAZINE_COUNT];
+    volatile LONG m_cCrossThreadFrees;
+    unsigned m_cMagazineRefills;          // protected by the heap lock
+    unsigned m_cMagazineFlushes;          // protected by the heap lock
+
     SinglePageArena* singlePageArenaList; // List of memory arenas exclusively for single page allocs
     SinglePageArena* singlePageArenaLast; // Last memory arena in list.
     
@@ -207,6 +270,8 @@ private:
 
     static int pageShift;           // log2 of the page size
     static bool reliableCommit;     // Commit of memory protects it correctly even if already committed
+    static size_t largePageSize;    // Large page size if arenas may be backed by large pages, else 0.
+    unsigned m_cLargePageArenas;    // Arenas currently backed by large pages.
 
     size_t m_pageCurUse, m_pageMaxUse;
     size_t m_pageCurReserve, m_pageMaxReserve;
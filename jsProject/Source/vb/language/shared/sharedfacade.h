@@ -148,13 +148,14 @@
 #include "GuardBase.h"
 #include "VBAllocator.h"
 #include "VBMath.h"
-#include "VBAllocWrapper.h"
 #include "TemplateUtil.h"
 #include "CComPtrEx.h"
 #include "ComUtil.h"
 #include "RefCountedPtr.h"
 #include "RefCountedData.h"
 #include "TinyLock.h"
+#include "SmallBlockHeap.h"
+#include "VBAllocWrapper.h"
 #include "MapUtil.h"
 #include "MultimapUtil.h"
 
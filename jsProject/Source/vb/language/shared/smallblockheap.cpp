@@ -0,0 +1,246 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+//  Size class allocator for small, individually freed objects
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "StdAfx.h"
+
+#if DEBUG
+
+void * SmallBlockHeap::Alloc(size_t cbSize)
+{
+    return VBAlloc(cbSize);
+}
+
+void SmallBlockHeap::Free(void * pv)
+{
+    if (pv)
+    {
+        VBFree(pv);
+    }
+}
+
+void SmallBlockHeap::ReleaseUnusedMemory()
+{
+}
+
+void SmallBlockHeap::Destroy()
+{
+}
+
+#else
+
+// All of this is statically zeroed, so it is usable before static construction.
+SmallBlockHeap::Cache SmallBlockHeap::s_caches[SMALLBLOCK_CACHE_COUNT];
+CTinyLock SmallBlockHeap::s_depotLock;
+SmallBlockHeap::FreeList SmallBlockHeap::s_depot[SMALLBLOCK_CLASS_COUNT];
+SmallBlockHeap::Chunk * SmallBlockHeap::s_pChunks;
+BYTE * SmallBlockHeap::s_pChunkNext;
+BYTE * SmallBlockHeap::s_pChunkLimit;
+
+SmallBlockHeap::Cache & SmallBlockHeap::GetCache()
+{
+    // Thread ids are multiples of 4.
+    return s_caches[(GetCurrentThreadId() >> 2) & (SMALLBLOCK_CACHE_COUNT - 1)];
+}
+
+void * SmallBlockHeap::Alloc(size_t cbSize)
+{
+    BlockHeader * pHeader;
+
+    if (cbSize > SMALLBLOCK_MAX_SIZE)
+    {
+        pHeader = (BlockHeader *)VBAlloc(VBMath::Add(cbSize, sizeof(BlockHeader)));
+        pHeader->iClass = LargeBlock;
+        return pHeader + 1;
+    }
+
+    size_t iClass = cbSize ? (cbSize - 1) / SMALLBLOCK_GRANULARITY : 0;
+
+    {
+        Cache & cache = GetCache();
+        CTinyGate gate(&cache.lock);
+
+        FreeList & list = cache.lists[iClass];
+        if (!list.pFirst)
+        {
+            Refill(iClass, list);
+        }
+
+        FreeBlock * pBlock = list.pFirst;
+        list.pFirst = pBlock->pNext;
+        list.cBlocks--;
+        cache.cLive++;
+
+        pHeader = (BlockHeader *)pBlock;
+    }
+
+    pHeader->iClass = iClass;
+    memset(pHeader + 1, 0, BlockSize(iClass) - sizeof(BlockHeader));
+    return pHeader + 1;
+}
+
+void SmallBlockHeap::Free(void * pv)
+{
+    if (!pv)
+    {
+        return;
+    }
+
+    BlockHeader * pHeader = (BlockHeader *)pv - 1;
+    size_t iClass = pHeader->iClass;
+
+    if (iClass == LargeBlock)
+    {
+        VBFree(pHeader);
+        return;
+    }
+
+    VSASSERT(iClass < SMALLBLOCK_CLASS_COUNT, "Invalid block header");
+
+    Cache & cache = GetCache();
+    CTinyGate gate(&cache.lock);
+
+    FreeList & list = cache.lists[iClass];
+    if (list.cBlocks >= SMALLBLOCK_CACHE_LIMIT)
+    {
+        ReleaseBatch(iClass, list);
+    }
+
+    FreeBlock * pBlock = (FreeBlock *)pHeader;
+    pBlock->pNext = list.pFirst;
+    list.pFirst = pBlock;
+    list.cBlocks++;
+    cache.cLive--;
+}
+
+/*
+* Move a batch of blocks of one class from the depot to a cache, carving new
+* blocks if the depot is empty.  The caller holds the cache lock.
+*/
+void SmallBlockHeap::Refill(size_t iClass, FreeList & list)
+{
+    CTinyGate gate(&s_depotLock);
+
+    FreeList & depot = s_depot[iClass];
+    size_t cbBlock = BlockSize(iClass);
+
+    for (unsigned i = 0; i < SMALLBLOCK_BATCH; i++)
+    {
+        FreeBlock * pBlock;
+
+        if (depot.pFirst)
+        {
+            pBlock = depot.pFirst;
+            depot.pFirst = pBlock->pNext;
+            depot.cBlocks--;
+        }
+        else
+        {
+            if ((size_t)(s_pChunkLimit - s_pChunkNext) < cbBlock)
+            {
+                // The tail of the old chunk is too small for this class and is
+                // simply left unused.
+                Chunk * pChunk = (Chunk *)VBAllocOpt(SMALLBLOCK_CHUNK_SIZE, HEAP_GENERATE_EXCEPTIONS);
+                pChunk->pNext = s_pChunks;
+                s_pChunks = pChunk;
+                s_pChunkNext = (BYTE *)pChunk + sizeof(BlockHeader);
+                s_pChunkLimit = (BYTE *)pChunk + SMALLBLOCK_CHUNK_SIZE;
+            }
+
+            pBlock = (FreeBlock *)s_pChunkNext;
+            s_pChunkNext += cbBlock;
+        }
+
+        pBlock->pNext = list.pFirst;
+        list.pFirst = pBlock;
+        list.cBlocks++;
+    }
+}
+
+/*
+* Give a batch of free blocks from a full cache back to the depot.  The caller
+* holds the cache lock.
+*/
+void SmallBlockHeap::ReleaseBatch(size_t iClass, FreeList & list)
+{
+    // Unlink the batch first so the depot lock is held only to splice it in.
+    FreeBlock * pFirst = list.pFirst;
+    FreeBlock * pLast = pFirst;
+    for (unsigned i = 1; i < SMALLBLOCK_BATCH; i++)
+    {
+        pLast = pLast->pNext;
+    }
+    list.pFirst = pLast->pNext;
+    list.cBlocks -= SMALLBLOCK_BATCH;
+
+    CTinyGate gate(&s_depotLock);
+
+    FreeList & depot = s_depot[iClass];
+    pLast->pNext = depot.pFirst;
+    depot.pFirst = pFirst;
+    depot.cBlocks += SMALLBLOCK_BATCH;
+}
+
+void SmallBlockHeap::ReleaseUnusedMemory()
+{
+    ReleaseChunks(false);
+}
+
+void SmallBlockHeap::Destroy()
+{
+    ReleaseChunks(true);
+}
+
+void SmallBlockHeap::ReleaseChunks(bool fDestroy)
+{
+    // Lock order: caches in index order, then the depot.
+    for (unsigned i = 0; i < SMALLBLOCK_CACHE_COUNT; i++)
+    {
+        s_caches[i].lock.Acquire();
+    }
+    s_depotLock.Acquire();
+
+    long cLive = 0;
+    for (unsigned i = 0; i < SMALLBLOCK_CACHE_COUNT; i++)
+    {
+        cLive += s_caches[i].cLive;
+    }
+
+    VSASSERT(!fDestroy || cLive == 0, "Small blocks are still in use when the common heap is destroyed");
+
+    if (cLive == 0)
+    {
+        Chunk * pNext;
+        for (Chunk * pChunk = s_pChunks; pChunk; pChunk = pNext)
+        {
+            pNext = pChunk->pNext;
+            VBFree(pChunk);
+        }
+    }
+
+    if (cLive == 0 || fDestroy)
+    {
+        // Blocks still in use at destruction are left to the destroyed heap.
+        s_pChunks = NULL;
+        s_pChunkNext = s_pChunkLimit = NULL;
+
+        memset(s_depot, 0, sizeof(s_depot));
+        for (unsigned i = 0; i < SMALLBLOCK_CACHE_COUNT; i++)
+        {
+            memset(s_caches[i].lists, 0, sizeof(s_caches[i].lists));
+            s_caches[i].cLive = 0;
+        }
+    }
+
+    s_depotLock.Release();
+    for (unsigned i = SMALLBLOCK_CACHE_COUNT; i-- > 0; )
+    {
+        s_caches[i].lock.Release();
+    }
+}
+
+#endif
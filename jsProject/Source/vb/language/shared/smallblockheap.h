@@ -0,0 +1,104 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+//  Size class allocator for small, individually freed objects
+//
+//-------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+//
+// List nodes, hash table buckets and iterators allocated through VBAllocWrapper are small and
+// freed one at a time.  Rather than give each one its own block in the common heap, they are
+// carved out of SMALLBLOCK_CHUNK_SIZE chunks and recycled through per size class free lists.
+//
+// Freed blocks go to a cache picked by thread id, so there is no contention between threads as
+// long as there are fewer busy threads than caches.  Caches hand blocks to and take blocks from a
+// shared depot SMALLBLOCK_BATCH at a time.
+//
+// Every block is preceded by a header holding its size class, so a block can be freed on any
+// thread and without knowing its size.  Requests larger than SMALLBLOCK_MAX_SIZE go straight to
+// the common heap.  Blocks are 8 byte aligned.
+//
+// In DEBUG builds everything goes to the common heap so that the debug heap keeps tracking leaks
+// per allocation.
+//
+//-------------------------------------------------------------------------------------------------
+
+#define SMALLBLOCK_GRANULARITY      16
+#define SMALLBLOCK_MAX_SIZE         256
+#define SMALLBLOCK_CLASS_COUNT      (SMALLBLOCK_MAX_SIZE / SMALLBLOCK_GRANULARITY)
+#define SMALLBLOCK_CHUNK_SIZE       (64 * 1024)
+#define SMALLBLOCK_CACHE_COUNT      16      // a power of 2.
+#define SMALLBLOCK_CACHE_LIMIT      128     // blocks of one class a cache holds before giving some back.
+#define SMALLBLOCK_BATCH            64      // blocks moved between a cache and the depot at once.
+
+class SmallBlockHeap
+{
+public:
+    // Returns zeroed memory; throws like VBAlloc if out of memory.
+    static void * Alloc(size_t cbSize);
+    static void Free(void * pv);
+
+    // Returns every chunk to the common heap if no blocks are in use.  Called
+    // where the page heap is shrunk.
+    static void ReleaseUnusedMemory();
+
+    // Called before the common heap is destroyed.  Returns the chunks like
+    // ReleaseUnusedMemory, and forgets them even if blocks are still in use, so
+    // that nothing is carved out of the destroyed heap after re-initialization.
+    static void Destroy();
+
+#if !DEBUG
+private:
+    struct FreeBlock
+    {
+        FreeBlock * pNext;
+    };
+
+    union BlockHeader
+    {
+        size_t iClass;              // size class, or LargeBlock.
+        double dAlign;              // keep the block 8 byte aligned on x86 too.
+    };
+
+    static const size_t LargeBlock = (size_t)-1;
+
+    struct FreeList
+    {
+        FreeBlock * pFirst;
+        unsigned cBlocks;
+    };
+
+    struct Cache
+    {
+        CTinyLock lock;
+        FreeList lists[SMALLBLOCK_CLASS_COUNT];
+        long cLive;                 // allocations less frees done through this cache; may be negative.
+    };
+
+    struct Chunk
+    {
+        Chunk * pNext;
+    };
+
+    static size_t BlockSize(size_t iClass)
+    {
+        return sizeof(BlockHeader) + (iClass + 1) * SMALLBLOCK_GRANULARITY;
+    }
+
+    static Cache & GetCache();
+    static void Refill(size_t iClass, FreeList & list);
+    static void ReleaseBatch(size_t iClass, FreeList & list);
+    static void ReleaseChunks(bool fDestroy);
+
+    static Cache s_caches[SMALLBLOCK_CACHE_COUNT];
+    static CTinyLock s_depotLock;                               // protects the members below.
+    static FreeList s_depot[SMALLBLOCK_CLASS_COUNT];
+    static Chunk * s_pChunks;
+    static BYTE * s_pChunkNext;                                 // uncarved part of the newest chunk.
+    static BYTE * s_pChunkLimit;
+#endif
+};
@@ -3,7 +3,8 @@
 //
 //  Copyright (c) Microsoft Corporation.  All rights reserved.
 //
-//  Uses the standard VB Common heap for its operations
+//  Uses the standard VB Common heap for its operations.  Single objects come from
+//  the SmallBlockHeap size classes; arrays come from the heap directly.
 //
 //-------------------------------------------------------------------------------------------------
 
@@ -14,13 +15,13 @@ class VBAllocWrapper
 public:
     template <class T> T * Allocate()
     {
-        return new (zeromemory) T();
+        return ::new (SmallBlockHeap::Alloc(sizeof(T))) T();
     }
 
     template <class T, class R1>
     T * Allocate(R1 argument1)
     {
-        return new (zeromemory) T(argument1);
+        return ::new (SmallBlockHeap::Alloc(sizeof(T))) T(argument1);
     }
 
     template <class T, class R1, class R2>
@@ -28,7 +29,7 @@ public:
         R1 argument1,
         R2 argument2)
     {
-        return new (zeromemory) T(argument1, argument2);
+        return ::new (SmallBlockHeap::Alloc(sizeof(T))) T(argument1, argument2);
     }
 
     template <class T, class R1, class R2, class R3>
@@ -37,7 +38,7 @@ public:
         R2 argument2,
         R3 argument3)
     {
-        return new (zeromemory) T(argument1, argument2, argument3);
+        return ::new (SmallBlockHeap::Alloc(sizeof(T))) T(argument1, argument2, argument3);
     }
 
     template <class T, class R1, class R2, class R3, class R4>
@@ -47,7 +48,7 @@ public:
         R3 argument3,
         R4 argument4)
     {
-        return new (zeromemory) T(argument1, argument2, argument3, argument4);
+        return ::new (SmallBlockHeap::Alloc(sizeof(T))) T(argument1, argument2, argument3, argument4);
     }
 
     template <class T, class R1, class R2, class R3, class R4, class R5>
@@ -58,7 +59,7 @@ public:
         R4 argument4,
         R5 argument5)
     {
-        return new (zeromemory) T(argument1, argument2, argument3, argument4, argument5);
+        return ::new (SmallBlockHeap::Alloc(sizeof(T))) T(argument1, argument2, argument3, argument4, argument5);
     }
 
     template <class T>
@@ -67,10 +68,15 @@ public:
         return new (zeromemory) T[count];
     }
 
+    // pData must have been returned by Allocate<T> for this same T.
     template <class T>
     void DeAllocate(T * pData)
     {
-        delete pData;
+        if (pData)
+        {
+            pData->~T();
+            SmallBlockHeap::Free(pData);
+        }
     }
 
     template <class T>
@@ -43,6 +43,9 @@ VBComModule::~VBComModule()
         delete g_pvbNorlsManager;
     }
 
+    // The small block chunks live in the common heap; give them back first.
+    SmallBlockHeap::Destroy();
+
     // If the initial heap creation fails, we will immediately be calleod with 
     // DLL_PROCESS_DETATCH and our heap will be invalid
     if ( g_vbCommonHeap )
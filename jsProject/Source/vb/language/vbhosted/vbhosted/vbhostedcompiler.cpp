@@ -75,6 +75,7 @@ STDMETHODIMP VbHostedCompiler::CompileExpression
     }
 
     g_pvbNorlsManager->GetPageHeap().ShrinkUnusedResources();
+    SmallBlockHeap::ReleaseUnusedMemory();
 
     VB_EXIT_LABEL();
 }